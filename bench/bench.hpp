@@ -0,0 +1,359 @@
+/*
+ * bench/bench.hpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Nico Madysa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENUMERATE_BENCH_HPP
+#define ENUMERATE_BENCH_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__) && __has_include(<linux/perf_event.h>)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define ENUMERATE_HAVE_PERF_EVENTS 1
+#endif
+
+
+/**A minimal benchmark harness for the `enumerate` headers.
+ *
+ * Every benchmark reports the wall-clock time per element and, where
+ * the kernel allows it, hardware counters per element: cycles,
+ * instructions, branch misses, L1 data cache misses and last-level
+ * cache misses. Counters that cannot be opened, e.g. inside a virtual
+ * machine or with a restrictive `perf_event_paranoid`, are reported as
+ * `-` while the timings are still shown.
+ */
+namespace bench {
+
+/// Keep the compiler from optimizing `value` away.
+template<typename T>
+inline void do_not_optimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+/// Keep the compiler from assuming that memory is unchanged.
+inline void clobber_memory() {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : : "memory");
+#endif
+}
+
+
+/// The hardware events that are counted.
+enum class Counter {
+    BEGIN,
+    Cycles = BEGIN,
+    Instructions,
+    BranchMisses,
+    L1DMisses,
+    LLCMisses,
+    END,
+};
+
+/// Number of counters.
+constexpr std::size_t counter_count = static_cast<std::size_t>(Counter::END);
+
+/// Column headers of the counters.
+constexpr const char* counter_names[counter_count] = {
+    "cycles", "instr", "br-miss", "L1D-miss", "LLC-miss",
+};
+
+
+/// The readings of all counters; negative if a counter is unavailable.
+using Readings = std::array<double, counter_count>;
+
+
+/**A set of hardware counters for the calling thread.
+ *
+ * Each counter is opened on its own, so that a single unsupported
+ * event does not disable the others. Readings are scaled up if the
+ * kernel had to multiplex the counters.
+ */
+class PerfCounters {
+public:
+    PerfCounters() {
+        m_fds.fill(-1);
+#ifdef ENUMERATE_HAVE_PERF_EVENTS
+        const std::pair<std::uint32_t, std::uint64_t> events[counter_count] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+            {PERF_TYPE_HW_CACHE, cache_event(PERF_COUNT_HW_CACHE_L1D)},
+            {PERF_TYPE_HW_CACHE, cache_event(PERF_COUNT_HW_CACHE_LL)},
+        };
+        for (std::size_t i = 0; i < counter_count; ++i) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = events[i].first;
+            attr.config = events[i].second;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            m_fds[i] = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator =(const PerfCounters&) = delete;
+
+    ~PerfCounters() {
+#ifdef ENUMERATE_HAVE_PERF_EVENTS
+        for (const int fd : m_fds) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+#endif
+    }
+
+    /// Return `true` if at least one counter could be opened.
+    bool available() const {
+        return std::any_of(m_fds.begin(), m_fds.end(), [](int fd) { return fd >= 0; });
+    }
+
+    /// Reset and start all counters.
+    void start() {
+#ifdef ENUMERATE_HAVE_PERF_EVENTS
+        for (const int fd : m_fds) {
+            if (fd >= 0) {
+                ::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    /// Stop all counters and return their readings.
+    Readings stop() {
+        Readings result;
+        result.fill(-1.0);
+#ifdef ENUMERATE_HAVE_PERF_EVENTS
+        for (std::size_t i = 0; i < counter_count; ++i) {
+            if (m_fds[i] >= 0) {
+                ::ioctl(m_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+        for (std::size_t i = 0; i < counter_count; ++i) {
+            std::uint64_t values[3];
+            if (m_fds[i] < 0 || ::read(m_fds[i], values, sizeof(values)) != sizeof(values)) {
+                continue;
+            }
+            // values = {count, time enabled, time running}.
+            result[i] = values[2] == 0 ? 0.0
+                : static_cast<double>(values[0]) * values[1] / values[2];
+        }
+#endif
+        return result;
+    }
+
+private:
+#ifdef ENUMERATE_HAVE_PERF_EVENTS
+    /// Return the configuration for read misses in `cache`.
+    static std::uint64_t cache_event(std::uint64_t cache) {
+        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                     | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+#endif
+
+    std::array<int, counter_count> m_fds;
+};
+
+
+/**Runs benchmarks and prints one line of results per benchmark.
+ *
+ * The only command-line argument is an optional substring; only
+ * benchmarks whose names contain it are run.
+ */
+class Runner {
+public:
+    Runner(int argc, char** argv) {
+        if (argc > 1) {
+            m_filter = argv[1];
+        }
+        if (!m_counters.available()) {
+            std::fprintf(stderr, "note: hardware counters are unavailable; "
+                                 "reporting wall-clock times only\n");
+        }
+        std::printf("%-44s %10s", "benchmark", "ns/elem");
+        for (const char* name : counter_names) {
+            std::printf(" %9s", name);
+        }
+        std::printf("\n");
+    }
+
+    /// Set the minimum measured time per benchmark.
+    void min_time(std::chrono::nanoseconds time) { m_min_time = time; }
+
+    /**Run `body()`, which processes `elements` elements per call.
+     *
+     * `body` is called in five rounds of equal length that together
+     * take at least the minimum time; the fastest round is reported.
+     */
+    template<typename Body>
+    void run(const std::string& name, std::size_t elements, Body body) {
+        if (name.find(m_filter) == std::string::npos) {
+            return;
+        }
+        std::size_t iterations = 1;
+        for (;;) {
+            const auto start = std::chrono::steady_clock::now();
+            for (std::size_t i = 0; i < iterations; ++i) {
+                body();
+            }
+            if (std::chrono::steady_clock::now() - start >= m_min_time / 5) {
+                break;
+            }
+            iterations *= 2;
+        }
+        double best_time = 0.0;
+        Readings best;
+        best.fill(-1.0);
+        for (int repetition = 0; repetition < 5; ++repetition) {
+            m_counters.start();
+            const auto start = std::chrono::steady_clock::now();
+            for (std::size_t i = 0; i < iterations; ++i) {
+                body();
+            }
+            const auto stop = std::chrono::steady_clock::now();
+            const Readings readings = m_counters.stop();
+            const double time = std::chrono::duration<double, std::nano>(stop - start).count();
+            if (repetition == 0 || time < best_time) {
+                best_time = time;
+                best = readings;
+            }
+        }
+        const double per_element = 1.0 / (static_cast<double>(iterations) * elements);
+        std::printf("%-44s %10.3f", name.c_str(), best_time * per_element);
+        for (const double reading : best) {
+            if (reading < 0) {
+                std::printf(" %9s", "-");
+            } else {
+                std::printf(" %9.3f", reading * per_element);
+            }
+        }
+        std::printf("\n");
+        std::fflush(stdout);
+    }
+
+private:
+    PerfCounters m_counters;
+    std::string m_filter;
+    std::chrono::nanoseconds m_min_time = std::chrono::milliseconds{100};
+};
+
+
+/**A fast, deterministic pseudo-random number generator (xorshift64*).
+ *
+ * Benchmarks use it to generate inputs, so that runs are comparable.
+ */
+class Random {
+public:
+    explicit Random(std::uint64_t seed = 0x9e3779b97f4a7c15ull) : m_state(seed | 1) {}
+
+    /// Return the next 64 random bits.
+    std::uint64_t next() {
+        m_state ^= m_state >> 12;
+        m_state ^= m_state << 25;
+        m_state ^= m_state >> 27;
+        return m_state * 0x2545f4914f6cdd1dull;
+    }
+
+    /// Return a number in `[0, bound)`.
+    std::uint64_t below(std::uint64_t bound) {
+        // The high half of the 128-bit product `next() * bound`, built
+        // from 32-bit halves so that it needs no compiler extension.
+        const std::uint64_t x = next();
+        const std::uint64_t x_low = x & 0xffffffffu;
+        const std::uint64_t x_high = x >> 32;
+        const std::uint64_t bound_low = bound & 0xffffffffu;
+        const std::uint64_t bound_high = bound >> 32;
+        const std::uint64_t low_low = x_low * bound_low;
+        const std::uint64_t high_low = x_high * bound_low;
+        const std::uint64_t middle =
+            (low_low >> 32) + (high_low & 0xffffffffu) + x_low * bound_high;
+        return x_high * bound_high + (high_low >> 32) + (middle >> 32);
+    }
+
+    /// Return a number in `[0, 1)`.
+    double uniform() { return (next() >> 11) * 0x1.0p-53; }
+
+private:
+    std::uint64_t m_state;
+};
+
+
+/**Draws numbers in `[0, size)` with a Zipf distribution.
+ *
+ * With `skew == 0`, all numbers are equally likely; the larger
+ * `skew`, the more often the small numbers are drawn.
+ */
+class Zipf {
+public:
+    Zipf(std::size_t size, double skew) : m_cumulative(size) {
+        double total = 0.0;
+        for (std::size_t i = 0; i < size; ++i) {
+            total += 1.0 / std::pow(static_cast<double>(i + 1), skew);
+            m_cumulative[i] = total;
+        }
+        for (double& value : m_cumulative) {
+            value /= total;
+        }
+    }
+
+    /// Draw a number.
+    std::size_t operator ()(Random& random) const {
+        const auto it = std::lower_bound(m_cumulative.begin(), m_cumulative.end(), random.uniform());
+        return std::min<std::size_t>(it - m_cumulative.begin(), m_cumulative.size() - 1);
+    }
+
+private:
+    std::vector<double> m_cumulative;
+};
+
+}
+
+#endif // ENUMERATE_BENCH_HPP
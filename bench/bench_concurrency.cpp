@@ -0,0 +1,253 @@
+/*
+ * Benchmarks of concurrent per-item counters, queues, flags and maps.
+ *
+ * Build and run with e.g.
+ *
+ *     g++ -std=c++17 -O2 -march=native -pthread -I. bench/bench_concurrency.cpp -o bench_concurrency
+ *     ./bench_concurrency [filter [max-threads]]
+ *
+ * Every benchmark runs on 1, 2, 4, ... threads up to the number of
+ * hardware threads, or up to `max-threads` if it is given.
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.hpp"
+#include "../enumerate.hpp"
+#include "../enumerate/containers.hpp"
+#include "../enumerate/profiler.hpp"
+
+
+enum class E8 : std::uint8_t { BEGIN, END = 8 };
+enum class E64 : std::uint8_t { BEGIN, END = 64 };
+enum class E1000 : std::uint16_t { BEGIN, END = 1000 };
+
+
+/// Number of operations every thread performs per benchmark.
+constexpr std::size_t operations = 1 << 17;
+
+/// Number of operations timed together; a single operation is
+/// shorter than a read of the clock.
+constexpr std::size_t batch = 64;
+
+
+/**Runs a workload on a growing number of threads.
+ *
+ * Prints the throughput of all threads together and percentiles of
+ * the latency per operation, measured over batches of `batch`
+ * operations. Threads start together after all have been created.
+ */
+class ContentionRunner {
+public:
+    ContentionRunner(int argc, char** argv) {
+        if (argc > 1) {
+            m_filter = argv[1];
+        }
+        m_max_threads = argc > 2 ? std::strtoul(argv[2], nullptr, 10)
+                                 : std::thread::hardware_concurrency();
+        m_max_threads = std::max<std::size_t>(m_max_threads, 1);
+        std::printf("%-44s %7s %10s %9s %9s %9s\n",
+                    "benchmark", "threads", "Mops/s", "p50-ns", "p99-ns", "p99.9-ns");
+    }
+
+    /**Call `op(thread, i, keys[thread][i])` for every operation `i`.
+     *
+     * `keys` holds one key stream per thread; `op` must be safe to
+     * call from all threads at once.
+     */
+    template<typename Enum, typename Op>
+    void run(const std::string& name, const std::vector<std::vector<Enum>>& keys, Op& op) {
+        if (name.find(m_filter) == std::string::npos) {
+            return;
+        }
+        for (std::size_t threads = 1;; threads = std::min(2 * threads, m_max_threads)) {
+            run_with(name, threads, keys, op);
+            if (threads == m_max_threads) {
+                break;
+            }
+        }
+    }
+
+    /// Return the largest number of threads used.
+    std::size_t max_threads() const { return m_max_threads; }
+
+private:
+    template<typename Enum, typename Op>
+    void run_with(const std::string& name, std::size_t threads,
+                  const std::vector<std::vector<Enum>>& keys, Op& op) {
+        std::vector<std::vector<double>> latencies(threads);
+        std::atomic<std::size_t> ready{0};
+        std::atomic<bool> go{false};
+        std::vector<std::thread> workers;
+        for (std::size_t thread = 0; thread < threads; ++thread) {
+            workers.emplace_back([&, thread] {
+                const std::vector<Enum>& stream = keys[thread];
+                std::vector<double>& latency = latencies[thread];
+                latency.reserve(operations / batch);
+                ready.fetch_add(1);
+                while (!go.load(std::memory_order_acquire)) {
+                    std::this_thread::yield();
+                }
+                for (std::size_t i = 0; i < operations; i += batch) {
+                    const auto start = std::chrono::steady_clock::now();
+                    for (std::size_t j = i; j < i + batch; ++j) {
+                        op(thread, j, stream[j]);
+                    }
+                    const auto stop = std::chrono::steady_clock::now();
+                    latency.push_back(
+                        std::chrono::duration<double, std::nano>(stop - start).count() / batch);
+                }
+            });
+        }
+        while (ready.load() < threads) {
+            std::this_thread::yield();
+        }
+        const auto start = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        const auto stop = std::chrono::steady_clock::now();
+
+        std::vector<double> all;
+        for (const std::vector<double>& latency : latencies) {
+            all.insert(all.end(), latency.begin(), latency.end());
+        }
+        const double seconds = std::chrono::duration<double>(stop - start).count();
+        std::printf("%-44s %7zu %10.2f %9.1f %9.1f %9.1f\n", name.c_str(), threads,
+                    threads * operations / seconds * 1e-6,
+                    percentile(all, 0.5), percentile(all, 0.99), percentile(all, 0.999));
+        std::fflush(stdout);
+    }
+
+    /// Return the `fraction` percentile of `values`, reordering them.
+    static double percentile(std::vector<double>& values, double fraction) {
+        const auto nth = values.begin() + static_cast<std::ptrdiff_t>(fraction * (values.size() - 1));
+        std::nth_element(values.begin(), nth, values.end());
+        return *nth;
+    }
+
+    std::string m_filter;
+    std::size_t m_max_threads;
+};
+
+
+/// Return one stream of `operations` keys per thread, drawn with `skew`.
+template<typename Enum>
+std::vector<std::vector<Enum>> make_keys(std::size_t threads, double skew) {
+    const bench::Zipf zipf{enumerate::Enumerate<Enum>::size(), skew};
+    std::vector<std::vector<Enum>> result(threads);
+    for (std::size_t thread = 0; thread < threads; ++thread) {
+        bench::Random random{0x9e3779b97f4a7c15ull * (thread + 1)};
+        result[thread].resize(operations);
+        for (Enum& key : result[thread]) {
+            key = enumerate::from_index<Enum>(zipf(random));
+        }
+    }
+    return result;
+}
+
+
+/// A queue guarded by a mutex, on its own cache line.
+struct alignas(64) LockedQueue {
+    std::mutex mutex;
+    std::deque<std::uint64_t> items;
+};
+
+
+/// Benchmark every primitive for one `enum` and key skew.
+template<typename Enum>
+void bench_enum(ContentionRunner& runner, const std::string& suffix, double skew) {
+    const auto keys = make_keys<Enum>(runner.max_threads(), skew);
+
+    // One atomic per item, adjacent items sharing cache lines.
+    enumerate::EnumMap<Enum, std::atomic<std::uint64_t>> atomics;
+    auto atomic_add = [&](std::size_t, std::size_t, Enum key) {
+        atomics[key].fetch_add(1, std::memory_order_relaxed);
+    };
+    runner.run("atomic-counters/add" + suffix, keys, atomic_add);
+
+    enumerate::ShardedEnumCounters<Enum> sharded;
+    auto sharded_add = [&](std::size_t, std::size_t, Enum key) {
+        sharded.add(key);
+    };
+    runner.run("ShardedEnumCounters/add" + suffix, keys, sharded_add);
+
+    // Mostly adds, with an occasional full snapshot by every thread.
+    auto sharded_snapshot = [&](std::size_t, std::size_t i, Enum key) {
+        if (i % 1024 == 0) {
+            bench::do_not_optimize(sharded.snapshot());
+        } else {
+            sharded.add(key);
+        }
+    };
+    runner.run("ShardedEnumCounters/add+snapshot" + suffix, keys, sharded_snapshot);
+
+    // Every operation is a push followed by a pop on the key's queue.
+    std::unique_ptr<LockedQueue[]> queues{new LockedQueue[enumerate::Enumerate<Enum>::size()]};
+    auto queue_op = [&](std::size_t thread, std::size_t, Enum key) {
+        LockedQueue& queue = queues[enumerate::to_index(key)];
+        const std::lock_guard<std::mutex> lock{queue.mutex};
+        queue.items.push_back(thread);
+        queue.items.pop_front();
+    };
+    runner.run("locked-queues/push+pop" + suffix, keys, queue_op);
+
+    // One write in eight; even threads insert, odd threads erase.
+    enumerate::AtomicEnumSet<Enum> flags;
+    auto flag_op = [&](std::size_t thread, std::size_t i, Enum key) {
+        if (i % 8 != 0) {
+            bench::do_not_optimize(flags.contains(key, std::memory_order_acquire));
+        } else if (thread % 2 == 0) {
+            flags.insert(key);
+        } else {
+            flags.erase(key);
+        }
+    };
+    runner.run("AtomicEnumSet/contains+update" + suffix, keys, flag_op);
+
+    // A read-mostly map replaced by copy-on-write; one write in 256.
+    using Snapshot = enumerate::EnumMap<Enum, std::uint64_t>;
+    std::shared_ptr<const Snapshot> snapshot = std::make_shared<Snapshot>();
+    auto snapshot_op = [&](std::size_t, std::size_t i, Enum key) {
+        auto current = std::atomic_load(&snapshot);
+        if (i % 256 != 0) {
+            bench::do_not_optimize((*current)[key]);
+            return;
+        }
+        for (;;) {
+            auto next = std::make_shared<Snapshot>(*current);
+            ++(*next)[key];
+            if (std::atomic_compare_exchange_weak(
+                    &snapshot, &current, std::shared_ptr<const Snapshot>{std::move(next)})) {
+                break;
+            }
+        }
+    };
+    runner.run("snapshot-map/read+copy-on-write" + suffix, keys, snapshot_op);
+}
+
+
+int main(int argc, char** argv) {
+    ContentionRunner runner{argc, argv};
+    for (const double skew : {0.0, 1.2}) {
+        const std::string suffix = skew == 0.0 ? "/uniform" : "/skewed";
+        bench_enum<E8>(runner, "/8" + suffix, skew);
+        bench_enum<E64>(runner, "/64" + suffix, skew);
+        bench_enum<E1000>(runner, "/1000" + suffix, skew);
+    }
+    return 0;
+}
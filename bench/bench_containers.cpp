@@ -0,0 +1,411 @@
+/*
+ * Benchmarks of enum-keyed containers against standard containers.
+ *
+ * Build and run with e.g.
+ *
+ *     g++ -std=c++17 -O2 -march=native -I. bench/bench_containers.cpp -o bench_containers
+ *     ./bench_containers [filter]
+ *
+ */
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "bench.hpp"
+#include "../enumerate.hpp"
+#include "../enumerate/containers.hpp"
+#include "../enumerate/permuted_map.hpp"
+#include "../enumerate/range_set.hpp"
+
+
+enum class E3 : std::uint8_t { BEGIN, END = 3 };
+enum class E64 : std::uint8_t { BEGIN, END = 64 };
+enum class E500 : std::uint16_t { BEGIN, END = 500 };
+enum class E5000 : std::uint16_t { BEGIN, END = 5000 };
+
+
+/// Number of keys in every access stream.
+constexpr std::size_t accesses = 1 << 14;
+
+
+/// Hash an `enum` through its underlying integer.
+struct EnumHash {
+    template<typename Enum>
+    std::size_t operator ()(Enum item) const {
+        return std::hash<std::size_t>{}(enumerate::to_index(item));
+    }
+};
+
+
+/// `EnumMap`.
+template<typename Enum, typename T>
+struct DenseAdapter {
+    enumerate::EnumMap<Enum, T> map;
+
+    T& operator [](Enum key) { return map[key]; }
+    template<typename F> void for_each(F f) const { for (const T& value : map) f(value); }
+    void merge(const DenseAdapter& other) {
+        for (std::size_t i = 0; i < map.size(); ++i) {
+            map.data()[i] += other.map.data()[i];
+        }
+    }
+};
+
+/// `std::array` with manual casts.
+template<typename Enum, typename T>
+struct ArrayAdapter {
+    std::array<T, enumerate::Enumerate<Enum>::size()> map{};
+
+    T& operator [](Enum key) { return map[static_cast<std::size_t>(key)]; }
+    template<typename F> void for_each(F f) const { for (const T& value : map) f(value); }
+    void merge(const ArrayAdapter& other) {
+        for (std::size_t i = 0; i < map.size(); ++i) {
+            map[i] += other.map[i];
+        }
+    }
+};
+
+/// `std::map`, filled with every key.
+template<typename Enum, typename T>
+struct MapAdapter {
+    std::map<Enum, T> map;
+
+    MapAdapter() {
+        for (const Enum key : enumerate::Enumerate<Enum>{}) {
+            map[key] = T{};
+        }
+    }
+    T& operator [](Enum key) { return map.find(key)->second; }
+    template<typename F> void for_each(F f) const { for (const auto& entry : map) f(entry.second); }
+    void merge(const MapAdapter& other) {
+        for (const auto& entry : other.map) {
+            map[entry.first] += entry.second;
+        }
+    }
+};
+
+/// `std::unordered_map`, filled with every key.
+template<typename Enum, typename T>
+struct HashAdapter {
+    std::unordered_map<Enum, T, EnumHash> map;
+
+    HashAdapter() {
+        for (const Enum key : enumerate::Enumerate<Enum>{}) {
+            map[key] = T{};
+        }
+    }
+    T& operator [](Enum key) { return map.find(key)->second; }
+    template<typename F> void for_each(F f) const { for (const auto& entry : map) f(entry.second); }
+    void merge(const HashAdapter& other) {
+        for (const auto& entry : other.map) {
+            map[entry.first] += entry.second;
+        }
+    }
+};
+
+
+/// Return `accesses` keys drawn with the given `skew`, hot keys scattered.
+template<typename Enum>
+std::vector<Enum> make_keys(double skew) {
+    constexpr std::size_t size = enumerate::Enumerate<Enum>::size();
+    bench::Random random;
+    const bench::Zipf zipf{size, skew};
+    std::vector<Enum> result(accesses);
+    for (Enum& key : result) {
+        // Spread the hot keys across the range, as in real enums.
+        key = enumerate::from_index<Enum>(zipf(random) * 7919 % size);
+    }
+    return result;
+}
+
+
+/// Benchmark lookup, update, iteration and merge on one map type.
+template<typename Map, typename Enum>
+void bench_map(bench::Runner& runner, const std::string& name,
+               const std::vector<Enum>& keys) {
+    constexpr std::size_t size = enumerate::Enumerate<Enum>::size();
+    Map map;
+    runner.run(name + "/update", keys.size(), [&] {
+        for (const Enum key : keys) {
+            ++map[key];
+        }
+        bench::clobber_memory();
+    });
+    runner.run(name + "/lookup", keys.size(), [&] {
+        std::uint64_t sum = 0;
+        for (const Enum key : keys) {
+            sum += map[key];
+        }
+        bench::do_not_optimize(sum);
+    });
+    runner.run(name + "/iterate", size, [&] {
+        std::uint64_t sum = 0;
+        map.for_each([&sum](std::uint64_t value) { sum += value; });
+        bench::do_not_optimize(sum);
+    });
+    Map other;
+    runner.run(name + "/merge", size, [&] {
+        map.merge(other);
+        bench::clobber_memory();
+    });
+}
+
+
+/// A record that fills a cache line, for the layout benchmarks.
+struct Record {
+    std::uint64_t hits;
+    std::uint64_t padding[7];
+};
+
+
+/// The 16 hottest keys of the skewed streams built by `make_keys()`.
+template<typename Enum, typename = std::make_index_sequence<
+    (enumerate::Enumerate<Enum>::size() < 16 ? enumerate::Enumerate<Enum>::size() : 16)>>
+struct HotProfile;
+
+template<typename Enum, std::size_t... Rank>
+struct HotProfile<Enum, std::index_sequence<Rank...>> {
+    static constexpr Enum hot[] = {
+        enumerate::from_index<Enum>(Rank * 7919 % enumerate::Enumerate<Enum>::size())...
+    };
+};
+
+
+/// Benchmark lookups of large records in enum order and in hot-first order.
+template<typename Enum>
+void bench_layout(bench::Runner& runner, const std::string& suffix,
+                  const std::vector<Enum>& keys) {
+    enumerate::EnumMap<Enum, Record> dense;
+    runner.run("EnumMap<Record>" + suffix, keys.size(), [&] {
+        for (const Enum key : keys) {
+            ++dense[key].hits;
+        }
+        bench::clobber_memory();
+    });
+    enumerate::PermutedEnumMap<Enum, Record, HotProfile<Enum>> permuted;
+    runner.run("PermutedEnumMap<Record>" + suffix, keys.size(), [&] {
+        for (const Enum key : keys) {
+            ++permuted[key].hits;
+        }
+        bench::clobber_memory();
+    });
+}
+
+
+/// Benchmark membership tests and unions of `EnumSet` and `std::bitset`.
+template<typename Enum>
+void bench_sets(bench::Runner& runner, const std::string& suffix,
+                const std::vector<Enum>& keys) {
+    constexpr std::size_t size = enumerate::Enumerate<Enum>::size();
+    enumerate::EnumSet<Enum> set;
+    enumerate::EnumSet<Enum> other;
+    std::bitset<size> bits;
+    std::bitset<size> other_bits;
+    for (std::size_t i = 0; i < size; i += 3) {
+        set.insert(enumerate::from_index<Enum>(i));
+        bits.set(i);
+    }
+    runner.run("EnumSet/contains" + suffix, keys.size(), [&] {
+        std::size_t hits = 0;
+        for (const Enum key : keys) {
+            hits += set.contains(key);
+        }
+        bench::do_not_optimize(hits);
+    });
+    runner.run("std::bitset/contains" + suffix, keys.size(), [&] {
+        std::size_t hits = 0;
+        for (const Enum key : keys) {
+            hits += bits.test(static_cast<std::size_t>(key));
+        }
+        bench::do_not_optimize(hits);
+    });
+    runner.run("EnumSet/union" + suffix, size, [&] {
+        other |= set;
+        bench::clobber_memory();
+    });
+    runner.run("std::bitset/union" + suffix, size, [&] {
+        other_bits |= bits;
+        bench::clobber_memory();
+    });
+}
+
+
+/// Benchmark `PackedColumn` against a plain column, and `EnumRangeSet`
+/// against `EnumSet` and `std::set`, on sets of four contiguous runs.
+template<typename Enum>
+void bench_compact(bench::Runner& runner, const std::string& suffix,
+                   const std::vector<Enum>& keys) {
+    constexpr std::size_t size = enumerate::Enumerate<Enum>::size();
+    const enumerate::PackedColumn<Enum> packed{keys.data(), keys.size()};
+    std::vector<std::size_t> positions(keys.size());
+    bench::Random random;
+    for (std::size_t& position : positions) {
+        position = static_cast<std::size_t>(random.below(keys.size()));
+    }
+    runner.run("std::vector<Enum>/scan" + suffix, keys.size(), [&] {
+        std::size_t sum = 0;
+        for (const Enum key : keys) {
+            sum += enumerate::to_index(key);
+        }
+        bench::do_not_optimize(sum);
+    });
+    runner.run("PackedColumn/scan" + suffix, keys.size(), [&] {
+        Enum buffer[1024];
+        std::size_t sum = 0;
+        for (std::size_t first = 0; first < packed.size(); first += 1024) {
+            const std::size_t count = std::min<std::size_t>(1024, packed.size() - first);
+            packed.unpack(first, count, buffer);
+            for (std::size_t i = 0; i < count; ++i) {
+                sum += enumerate::to_index(buffer[i]);
+            }
+        }
+        bench::do_not_optimize(sum);
+    });
+    runner.run("std::vector<Enum>/random" + suffix, positions.size(), [&] {
+        std::size_t sum = 0;
+        for (const std::size_t position : positions) {
+            sum += enumerate::to_index(keys[position]);
+        }
+        bench::do_not_optimize(sum);
+    });
+    runner.run("PackedColumn/random" + suffix, positions.size(), [&] {
+        std::size_t sum = 0;
+        for (const std::size_t position : positions) {
+            sum += enumerate::to_index(packed[position]);
+        }
+        bench::do_not_optimize(sum);
+    });
+
+    enumerate::EnumRangeSet<Enum> ranges;
+    for (std::size_t run = 0; run < 4; ++run) {
+        ranges.insert(enumerate::from_index<Enum>(size * (2 * run) / 8),
+                      enumerate::from_index<Enum>(size * (2 * run + 1) / 8 + 1));
+    }
+    const enumerate::EnumSet<Enum> set = ranges.to_set();
+    std::set<Enum> tree;
+    for (const Enum item : ranges) {
+        tree.insert(item);
+    }
+    runner.run("EnumRangeSet/contains" + suffix, keys.size(), [&] {
+        std::size_t hits = 0;
+        for (const Enum key : keys) {
+            hits += ranges.contains(key);
+        }
+        bench::do_not_optimize(hits);
+    });
+    runner.run("EnumSet/contains-runs" + suffix, keys.size(), [&] {
+        std::size_t hits = 0;
+        for (const Enum key : keys) {
+            hits += set.contains(key);
+        }
+        bench::do_not_optimize(hits);
+    });
+    runner.run("std::set/contains-runs" + suffix, keys.size(), [&] {
+        std::size_t hits = 0;
+        for (const Enum key : keys) {
+            hits += tree.count(key);
+        }
+        bench::do_not_optimize(hits);
+    });
+}
+
+
+/// Benchmark grouping values by key: `EnumMap` of vectors against
+/// `std::multimap` and `std::unordered_multimap`.
+template<typename Enum>
+void bench_multi(bench::Runner& runner, const std::string& suffix,
+                 const std::vector<Enum>& keys) {
+    enumerate::EnumMap<Enum, std::vector<std::uint32_t>> dense;
+    runner.run("EnumMap<vector>/insert" + suffix, keys.size(), [&] {
+        for (std::vector<std::uint32_t>& values : dense) {
+            values.clear();
+        }
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            dense[keys[i]].push_back(static_cast<std::uint32_t>(i));
+        }
+        bench::clobber_memory();
+    });
+    runner.run("EnumMap<vector>/visit" + suffix, keys.size(), [&] {
+        std::uint64_t sum = 0;
+        for (const Enum key : enumerate::Enumerate<Enum>{}) {
+            for (const std::uint32_t value : dense[key]) {
+                sum += value;
+            }
+        }
+        bench::do_not_optimize(sum);
+    });
+    std::multimap<Enum, std::uint32_t> tree;
+    runner.run("std::multimap/insert" + suffix, keys.size(), [&] {
+        tree.clear();
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            tree.emplace(keys[i], static_cast<std::uint32_t>(i));
+        }
+        bench::clobber_memory();
+    });
+    runner.run("std::multimap/visit" + suffix, keys.size(), [&] {
+        std::uint64_t sum = 0;
+        for (const Enum key : enumerate::Enumerate<Enum>{}) {
+            const auto range = tree.equal_range(key);
+            for (auto it = range.first; it != range.second; ++it) {
+                sum += it->second;
+            }
+        }
+        bench::do_not_optimize(sum);
+    });
+    std::unordered_multimap<Enum, std::uint32_t, EnumHash> hash;
+    hash.reserve(keys.size());
+    runner.run("std::unordered_multimap/insert" + suffix, keys.size(), [&] {
+        hash.clear();
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            hash.emplace(keys[i], static_cast<std::uint32_t>(i));
+        }
+        bench::clobber_memory();
+    });
+    runner.run("std::unordered_multimap/visit" + suffix, keys.size(), [&] {
+        std::uint64_t sum = 0;
+        for (const Enum key : enumerate::Enumerate<Enum>{}) {
+            const auto range = hash.equal_range(key);
+            for (auto it = range.first; it != range.second; ++it) {
+                sum += it->second;
+            }
+        }
+        bench::do_not_optimize(sum);
+    });
+}
+
+
+/// Benchmark all containers for one `enum` size and key skew.
+template<typename Enum>
+void bench_size(bench::Runner& runner, const std::string& size_name) {
+    for (const double skew : {0.0, 1.2}) {
+        const auto keys = make_keys<Enum>(skew);
+        const std::string suffix = "/" + size_name + (skew == 0.0 ? "/uniform" : "/skewed");
+        bench_map<DenseAdapter<Enum, std::uint64_t>>(runner, "EnumMap" + suffix, keys);
+        bench_map<ArrayAdapter<Enum, std::uint64_t>>(runner, "std::array" + suffix, keys);
+        bench_map<MapAdapter<Enum, std::uint64_t>>(runner, "std::map" + suffix, keys);
+        bench_map<HashAdapter<Enum, std::uint64_t>>(runner, "std::unordered_map" + suffix, keys);
+        bench_layout(runner, suffix, keys);
+        bench_sets(runner, suffix, keys);
+        bench_compact(runner, suffix, keys);
+        bench_multi(runner, suffix, keys);
+    }
+}
+
+
+int main(int argc, char** argv) {
+    bench::Runner runner{argc, argv};
+    bench_size<E3>(runner, "3");
+    bench_size<E64>(runner, "64");
+    bench_size<E500>(runner, "500");
+    bench_size<E5000>(runner, "5000");
+    return 0;
+}
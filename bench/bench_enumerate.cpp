@@ -0,0 +1,143 @@
+/*
+ * Benchmarks of enumeration, containers and bulk kernels.
+ *
+ * Build and run with e.g.
+ *
+ *     g++ -std=c++17 -O2 -march=native -I. bench/bench_enumerate.cpp -o bench_enumerate
+ *     ./bench_enumerate [filter]
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "../enumerate.hpp"
+#include "../enumerate/containers.hpp"
+#include "../enumerate/entropy.hpp"
+#include "../enumerate/filter.hpp"
+
+
+enum class E3 : std::uint8_t { BEGIN, END = 3 };
+enum class E64 : std::uint8_t { BEGIN, END = 64 };
+enum class E200 : std::uint8_t { BEGIN, END = 200 };
+enum class E5000 : std::uint16_t { BEGIN, END = 5000 };
+
+
+/// Number of items in every generated column.
+constexpr std::size_t rows = 1 << 16;
+
+
+/// Return a column of `rows` items drawn with the given `skew`.
+template<typename Enum>
+std::vector<Enum> make_column(double skew) {
+    bench::Random random;
+    const bench::Zipf zipf{enumerate::Enumerate<Enum>::size(), skew};
+    std::vector<Enum> result(rows);
+    for (Enum& item : result) {
+        item = enumerate::from_index<Enum>(zipf(random));
+    }
+    return result;
+}
+
+
+/// Benchmark iteration over all items of `Enum`.
+template<typename Enum>
+void bench_iteration(bench::Runner& runner, const std::string& suffix) {
+    runner.run("enumerate/forward/" + suffix, enumerate::Enumerate<Enum>::size(), [] {
+        std::size_t sum = 0;
+        for (const Enum item : enumerate::Enumerate<Enum>{}) {
+            bench::do_not_optimize(item);
+            sum += enumerate::to_index(item);
+        }
+        bench::do_not_optimize(sum);
+    });
+    runner.run("enumerate/reverse/" + suffix, enumerate::Enumerate<Enum>::size(), [] {
+        constexpr auto range = enumerate::Enumerate<Enum>{};
+        std::size_t sum = 0;
+        for (auto it = range.rbegin(); it != range.rend(); ++it) {
+            bench::do_not_optimize(*it);
+            sum += enumerate::to_index(*it);
+        }
+        bench::do_not_optimize(sum);
+    });
+}
+
+
+/// Benchmark containers keyed by `Enum`.
+template<typename Enum>
+void bench_containers(bench::Runner& runner, const std::string& suffix) {
+    const auto column = make_column<Enum>(1.0);
+    runner.run("EnumMap/increment/" + suffix, rows, [&] {
+        enumerate::EnumMap<Enum, std::uint32_t> counts;
+        for (const Enum item : column) {
+            ++counts[item];
+        }
+        bench::do_not_optimize(counts);
+    });
+    enumerate::EnumSet<Enum> set;
+    for (std::size_t i = 0; i < enumerate::Enumerate<Enum>::size(); i += 3) {
+        set.insert(enumerate::from_index<Enum>(i));
+    }
+    runner.run("EnumSet/contains/" + suffix, rows, [&] {
+        std::size_t hits = 0;
+        for (const Enum item : column) {
+            hits += set.contains(item);
+        }
+        bench::do_not_optimize(hits);
+    });
+    const enumerate::PackedColumn<Enum> packed{column.data(), column.size()};
+    std::vector<Enum> unpacked(rows);
+    runner.run("PackedColumn/unpack/" + suffix, rows, [&] {
+        packed.unpack(0, rows, unpacked.data());
+        bench::clobber_memory();
+    });
+}
+
+
+/// Benchmark bulk kernels over columns of `Enum`.
+template<typename Enum>
+void bench_kernels(bench::Runner& runner, const std::string& suffix) {
+    const auto column = make_column<Enum>(1.0);
+    std::vector<std::uint64_t> bitmap(enumerate::bitmap_words(rows));
+    runner.run("select_equal/" + suffix, rows, [&] {
+        enumerate::select_equal(column.data(), rows, Enum::BEGIN, bitmap.data());
+        bench::clobber_memory();
+    });
+    enumerate::EnumSet<Enum> small{Enum::BEGIN, enumerate::from_index<Enum>(2)};
+    runner.run("select_in/2-items/" + suffix, rows, [&] {
+        enumerate::select_in(column.data(), rows, small, bitmap.data());
+        bench::clobber_memory();
+    });
+    enumerate::EnumSet<Enum> large;
+    for (std::size_t i = 0; i < enumerate::Enumerate<Enum>::size(); i += 2) {
+        large.insert(enumerate::from_index<Enum>(i));
+    }
+    runner.run("select_in/half/" + suffix, rows, [&] {
+        enumerate::select_in(column.data(), rows, large, bitmap.data());
+        bench::clobber_memory();
+    });
+    runner.run("histogram/" + suffix, rows, [&] {
+        bench::do_not_optimize(enumerate::histogram(column.data(), rows));
+    });
+    runner.run("compress/" + suffix, rows, [&] {
+        bench::do_not_optimize(enumerate::compress(column.data(), rows));
+    });
+}
+
+
+int main(int argc, char** argv) {
+    bench::Runner runner{argc, argv};
+    bench_iteration<E3>(runner, "3");
+    bench_iteration<E64>(runner, "64");
+    bench_iteration<E5000>(runner, "5000");
+    bench_containers<E3>(runner, "3");
+    bench_containers<E64>(runner, "64");
+    bench_containers<E5000>(runner, "5000");
+    bench_kernels<E3>(runner, "3");
+    bench_kernels<E200>(runner, "200");
+    bench_kernels<E5000>(runner, "5000");
+    return 0;
+}
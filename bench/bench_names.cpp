@@ -0,0 +1,272 @@
+/*
+ * Benchmarks of conversions between enums and their names.
+ *
+ * Build and run with e.g.
+ *
+ *     g++ -std=c++17 -O2 -march=native -I. bench/bench_names.cpp -o bench_names
+ *     ./bench_names [filter]
+ *
+ * Compile with -std=c++20 to include `std::format`, and with
+ * -DENUMERATE_WITH_FMT -lfmt to include `fmt::format`.
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "bench.hpp"
+#include "../enumerate.hpp"
+#include "../enumerate/format.hpp"
+#include "../enumerate/names.hpp"
+
+
+// The benchmarked enums are defined once through these lists, so that
+// the hand-written baselines and the registered names cannot disagree.
+
+#define FRUIT_ITEMS(X) X(Apple) X(Orange) X(Pear)
+
+#define FIELD_ITEMS(X) \
+    X(AcceptEncoding) X(AcceptLanguage) X(AccessControlAllowOrigin) X(Age) \
+    X(Allow) X(AltSvc) X(Authorization) X(CacheControl) X(Connection) \
+    X(ContentDisposition) X(ContentEncoding) X(ContentLanguage) \
+    X(ContentLength) X(ContentLocation) X(ContentRange) X(ContentType) \
+    X(Cookie) X(Date) X(ETag) X(Expect) X(Expires) X(Forwarded) X(From) \
+    X(Host) X(IfMatch) X(IfModifiedSince) X(IfNoneMatch) X(IfRange) \
+    X(IfUnmodifiedSince) X(KeepAlive) X(LastModified) X(Link) X(Location) \
+    X(MaxForwards) X(Origin) X(Pragma) X(ProxyAuthenticate) \
+    X(ProxyAuthorization) X(Range) X(Referer) X(ReferrerPolicy) X(RetryAfter) \
+    X(SecFetchDest) X(SecFetchMode) X(SecFetchSite) X(SecFetchUser) X(Server) \
+    X(SetCookie) X(StrictTransportSecurity) X(TE) X(Trailer) \
+    X(TransferEncoding) X(Upgrade) X(UpgradeInsecureRequests) X(UserAgent) \
+    X(Vary) X(Via) X(WWWAuthenticate) X(Warning) X(XContentTypeOptions) \
+    X(XForwardedFor) X(XForwardedHost) X(XForwardedProto) X(XFrameOptions)
+
+#define ENUM_ITEM(name) name,
+#define NAME_ITEM(name) #name,
+#define SWITCH_ITEM(name) case Type::name: return #name;
+
+enum class Fruit { FRUIT_ITEMS(ENUM_ITEM) END, BEGIN = 0 };
+enum class Field : std::uint8_t { FIELD_ITEMS(ENUM_ITEM) END, BEGIN = 0 };
+
+template<>
+struct enumerate::EnumNames<Fruit> {
+    static constexpr const char* names[] = {FRUIT_ITEMS(NAME_ITEM)};
+};
+
+template<>
+struct enumerate::EnumNames<Field> {
+    static constexpr const char* names[] = {FIELD_ITEMS(NAME_ITEM)};
+};
+
+
+/// Return the name of `f` with a `switch`, as in example.cpp.
+const char* name(Fruit f) {
+    using Type = Fruit;
+    switch (f) {
+    FRUIT_ITEMS(SWITCH_ITEM)
+    default:
+        throw std::out_of_range("Fruit");
+    }
+}
+
+/// Return the name of `f` with a `switch`, as in example.cpp.
+const char* name(Field f) {
+    using Type = Field;
+    switch (f) {
+    FIELD_ITEMS(SWITCH_ITEM)
+    default:
+        throw std::out_of_range("Field");
+    }
+}
+
+
+/// Number of tokens in every generated text.
+constexpr std::size_t tokens = 1 << 14;
+
+
+/// Return `tokens` names drawn with a Zipf distribution, of which
+/// `unknown` is the fraction of names that belong to no item.
+template<typename Enum>
+std::vector<std::string> make_tokens(double unknown) {
+    bench::Random random;
+    const bench::Zipf zipf{enumerate::Enumerate<Enum>::size(), 1.0};
+    std::vector<std::string> result(tokens);
+    for (std::string& token : result) {
+        const auto item = enumerate::from_index<Enum>(zipf(random));
+        token = name(item);
+        if (random.uniform() < unknown) {
+            // Near misses are the expensive unknowns: same length and
+            // prefix as a real name, so that they hash and compare late.
+            token.back() ^= 0x20;
+        }
+    }
+    return result;
+}
+
+/// Join `tokens` into a text with one token per line.
+std::string join(const std::vector<std::string>& tokens) {
+    std::string result;
+    for (const std::string& token : tokens) {
+        result += token;
+        result += '\n';
+    }
+    return result;
+}
+
+
+/// Parses names by linear search over the `switch`-based names.
+template<typename Enum>
+struct LinearParser {
+    std::optional<Enum> operator ()(std::string_view token) const {
+        for (const Enum item : enumerate::Enumerate<Enum>{}) {
+            if (token == name(item)) {
+                return item;
+            }
+        }
+        return std::nullopt;
+    }
+};
+
+/// Parses names through a `std::unordered_map<std::string, Enum>`.
+template<typename Enum>
+struct HashParser {
+    std::unordered_map<std::string, Enum> map;
+
+    HashParser() {
+        for (const Enum item : enumerate::Enumerate<Enum>{}) {
+            map.emplace(name(item), item);
+        }
+    }
+
+    std::optional<Enum> operator ()(std::string_view token) const {
+        // Without heterogeneous lookup, every lookup builds a string.
+        const auto it = map.find(std::string{token});
+        if (it == map.end()) {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+};
+
+/// Parses names through the `NamePool`'s perfect hash table.
+template<typename Enum>
+struct PoolParser {
+    std::optional<Enum> operator ()(std::string_view token) const {
+        return enumerate::parse<Enum>(token);
+    }
+};
+
+
+/// Benchmark parsing single tokens and whole texts with `parser`.
+template<typename Enum, typename Parser>
+void bench_parser(bench::Runner& runner, const std::string& name, const Parser& parser,
+                  const std::vector<std::string>& words, const std::string& text) {
+    std::vector<std::string_view> views(words.begin(), words.end());
+    runner.run("parse/" + name, views.size(), [&] {
+        std::size_t known = 0;
+        for (const std::string_view token : views) {
+            known += parser(token).has_value();
+        }
+        bench::do_not_optimize(known);
+    });
+    std::vector<Enum> column(words.size());
+    runner.run("bulk-parse/" + name, words.size(), [&] {
+        Enum* out = column.data();
+        std::size_t begin = 0;
+        for (std::size_t end = text.find('\n'); end != std::string::npos;
+             begin = end + 1, end = text.find('\n', begin)) {
+            const auto item = parser(std::string_view{text}.substr(begin, end - begin));
+            *out++ = item ? *item : Enum::END;
+        }
+        bench::clobber_memory();
+    });
+}
+
+
+/// Benchmark all conversions of `Enum`.
+template<typename Enum>
+void bench_enum(bench::Runner& runner, const std::string& size_name) {
+    const auto known = make_tokens<Enum>(0.0);
+    std::vector<Enum> column;
+    for (const std::string& token : known) {
+        column.push_back(*enumerate::parse<Enum>(token));
+    }
+
+    runner.run("to-name/switch/" + size_name, column.size(), [&] {
+        std::size_t length = 0;
+        for (const Enum item : column) {
+            length += std::strlen(name(item));
+        }
+        bench::do_not_optimize(length);
+    });
+    runner.run("to-name/NamePool/" + size_name, column.size(), [&] {
+        std::size_t length = 0;
+        for (const Enum item : column) {
+            length += enumerate::to_name(item).size();
+        }
+        bench::do_not_optimize(length);
+    });
+
+    for (const double unknown : {0.0, 0.1}) {
+        const auto words = make_tokens<Enum>(unknown);
+        const auto text = join(words);
+        const std::string suffix =
+            size_name + (unknown == 0.0 ? "/known" : "/10%-unknown");
+        bench_parser<Enum>(runner, "linear/" + suffix, LinearParser<Enum>{}, words, text);
+        bench_parser<Enum>(runner, "unordered_map/" + suffix, HashParser<Enum>{}, words, text);
+        bench_parser<Enum>(runner, "NamePool/" + suffix, PoolParser<Enum>{}, words, text);
+    }
+
+    std::string out;
+    out.reserve(join(known).size());
+    runner.run("bulk-format/switch/" + size_name, column.size(), [&] {
+        out.clear();
+        for (const Enum item : column) {
+            out += name(item);
+            out += '\n';
+        }
+        bench::do_not_optimize(out.data());
+    });
+    runner.run("bulk-format/NamePool/" + size_name, column.size(), [&] {
+        out.clear();
+        for (const Enum item : column) {
+            out += enumerate::NamePool<Enum>::name(item);
+            out += '\n';
+        }
+        bench::do_not_optimize(out.data());
+    });
+#if defined(__cpp_lib_format) && defined(__cpp_concepts)
+    runner.run("bulk-format/std::format/" + size_name, column.size(), [&] {
+        out.clear();
+        for (const Enum item : column) {
+            std::format_to(std::back_inserter(out), "{}\n", item);
+        }
+        bench::do_not_optimize(out.data());
+    });
+#endif
+#ifdef ENUMERATE_WITH_FMT
+    runner.run("bulk-format/fmt::format/" + size_name, column.size(), [&] {
+        out.clear();
+        for (const Enum item : column) {
+            fmt::format_to(std::back_inserter(out), "{}\n", item);
+        }
+        bench::do_not_optimize(out.data());
+    });
+#endif
+}
+
+
+int main(int argc, char** argv) {
+    bench::Runner runner{argc, argv};
+    bench_enum<Fruit>(runner, "3");
+    bench_enum<Field>(runner, "64");
+    return 0;
+}
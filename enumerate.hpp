@@ -29,6 +29,7 @@
 #ifndef ENUMERATE_HPP
 #define ENUMERATE_HPP
 
+#include <cstddef>
 #include <type_traits>
 
 
@@ -194,6 +195,13 @@ struct Enumerate {
     // The initial value must be smaller than the final value.
     static_assert(begin_value <= end_value);
 
+    /// Return the number of items between `BEGIN` and `END`.
+    static constexpr std::size_t size() {
+        return static_cast<std::size_t>(
+            static_cast<integral_type>(end_value)
+            - static_cast<integral_type>(begin_value));
+    }
+
     /// Return an iterator to the `enum`'s initial value.
     constexpr iterator begin() const {
         return iterator{begin_value};
@@ -219,6 +227,26 @@ struct Enumerate {
 };
 
 
+/// Return the zero-based position of `value` in the `enum`'s range.
+template<typename Enum>
+constexpr std::size_t to_index(Enum value) {
+    using integral_type = typename Enumerate<Enum>::integral_type;
+    return static_cast<std::size_t>(
+        static_cast<integral_type>(value)
+        - static_cast<integral_type>(Enumerate<Enum>::begin_value));
+}
+
+
+/// Return the `enum` item at the zero-based position `index`.
+template<typename Enum>
+constexpr Enum from_index(std::size_t index) {
+    using integral_type = typename Enumerate<Enum>::integral_type;
+    return static_cast<Enum>(
+        static_cast<integral_type>(Enumerate<Enum>::begin_value)
+        + static_cast<integral_type>(index));
+}
+
+
 #ifdef __cpp_variable_templates
 /**Variable template that is equivalent to `Enumerate`.
  *
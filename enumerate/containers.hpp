@@ -0,0 +1,568 @@
+/*
+ * enumerate/containers.hpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Nico Madysa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENUMERATE_CONTAINERS_HPP
+#define ENUMERATE_CONTAINERS_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <vector>
+
+#include "../enumerate.hpp"
+
+
+namespace enumerate {
+
+namespace detail {
+
+/// Return the number of trailing zero bits in the non-zero `word`.
+inline int count_trailing_zeros(std::uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(word);
+#else
+    int result = 0;
+    while ((word & 1) == 0) {
+        word >>= 1;
+        ++result;
+    }
+    return result;
+#endif
+}
+
+/// Return the number of set bits in `word`.
+inline int popcount(std::uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(word);
+#else
+    int result = 0;
+    for (; word != 0; word &= word - 1) {
+        ++result;
+    }
+    return result;
+#endif
+}
+
+}
+
+
+/**A fixed-size array that is indexed by the items of an `enum`.
+ *
+ * The `enum` must follow the protocol described at `Enumerate`. Every
+ * item between `BEGIN` and `END` owns exactly one slot, so lookup is a
+ * subtraction and a load. The storage is a plain `std::array`, so maps
+ * of trivially copyable values are trivially copyable themselves.
+ */
+template<typename Enum, typename T>
+class EnumMap {
+public:
+    /// `Enum`.
+    using key_type = Enum;
+
+    /// `T`.
+    using mapped_type = T;
+
+    /// Number of slots, i.e. the number of items in `Enum`.
+    static constexpr std::size_t static_size = Enumerate<Enum>::size();
+
+    /// The underlying storage.
+    using storage_type = std::array<T, static_size>;
+
+    using iterator = typename storage_type::iterator;
+    using const_iterator = typename storage_type::const_iterator;
+
+    /// Value-initialize every slot.
+    constexpr EnumMap() = default;
+
+    /// Initialize every slot with a copy of `value`.
+    explicit EnumMap(const T& value) {
+        m_data.fill(value);
+    }
+
+    /// Return the slot of `key`, unchecked.
+    constexpr T& operator [](Enum key) { return m_data[to_index(key)]; }
+
+    /// Return the slot of `key`, unchecked.
+    constexpr const T& operator [](Enum key) const {
+        return m_data[to_index(key)];
+    }
+
+    /// Return the slot of `key`.
+    /// \throws std::out_of_range if `key` is not between `BEGIN` and `END`.
+    constexpr T& at(Enum key) { return m_data.at(to_index(key)); }
+
+    /// Return the slot of `key`.
+    /// \throws std::out_of_range if `key` is not between `BEGIN` and `END`.
+    constexpr const T& at(Enum key) const { return m_data.at(to_index(key)); }
+
+    /// Return the range of keys, in order.
+    static constexpr Enumerate<Enum> keys() { return Enumerate<Enum>{}; }
+
+    /// Return the number of slots.
+    static constexpr std::size_t size() { return static_size; }
+
+    /// Assign `value` to every slot.
+    void fill(const T& value) { m_data.fill(value); }
+
+    /// Return a pointer to the first slot.
+    constexpr T* data() { return m_data.data(); }
+    constexpr const T* data() const { return m_data.data(); }
+
+    /// Iterate over the values in key order.
+    constexpr iterator begin() { return m_data.begin(); }
+    constexpr iterator end() { return m_data.end(); }
+    const_iterator begin() const { return m_data.begin(); }
+    const_iterator end() const { return m_data.end(); }
+
+    /// Maps are equal if all of their slots are equal.
+    bool operator ==(const EnumMap& rhs) const { return m_data == rhs.m_data; }
+    bool operator !=(const EnumMap& rhs) const { return m_data != rhs.m_data; }
+
+private:
+    /// One slot per item.
+    storage_type m_data{};
+};
+
+
+/**A set of items of an `enum`, stored as a bitset.
+ *
+ * Bit `i` of the set corresponds to the item at position `i` of the
+ * `enum`'s range. Membership, insertion and removal are single bit
+ * operations; set algebra works one 64-bit word at a time.
+ */
+template<typename Enum>
+class EnumSet {
+public:
+    /// `Enum`.
+    using value_type = Enum;
+
+    /// The type of a single word of the bitset.
+    using word_type = std::uint64_t;
+
+    /// Number of bits per word.
+    static constexpr std::size_t word_bits = 64;
+
+    /// Number of items in `Enum`, i.e. the number of usable bits.
+    static constexpr std::size_t universe_size = Enumerate<Enum>::size();
+
+    /// Number of words needed to hold one bit per item.
+    static constexpr std::size_t word_count =
+        (universe_size + word_bits - 1) / word_bits;
+
+    /// A forward iterator over the items in the set, in `enum` order.
+    class const_iterator {
+    public:
+        using value_type = Enum;
+
+        const_iterator(const EnumSet* set, std::size_t index)
+            : m_set(set), m_index(index)
+        {
+            advance_to_member();
+        }
+
+        /// Return the current item.
+        constexpr Enum operator *() const { return from_index<Enum>(m_index); }
+
+        /// Advance to the next item in the set.
+        const_iterator& operator ++() {
+            ++m_index;
+            advance_to_member();
+            return *this;
+        }
+
+        constexpr bool operator ==(const const_iterator& rhs) const {
+            return m_index == rhs.m_index;
+        }
+
+        constexpr bool operator !=(const const_iterator& rhs) const {
+            return m_index != rhs.m_index;
+        }
+
+    private:
+        /// Skip forward to the next set bit, or to the end.
+        void advance_to_member() {
+            while (m_index < universe_size) {
+                const word_type word =
+                    m_set->m_words[m_index / word_bits] >> (m_index % word_bits);
+                if (word != 0) {
+                    m_index += detail::count_trailing_zeros(word);
+                    return;
+                }
+                m_index = (m_index / word_bits + 1) * word_bits;
+            }
+            m_index = universe_size;
+        }
+
+        const EnumSet* m_set;
+        std::size_t m_index;
+    };
+
+    /// Create an empty set.
+    constexpr EnumSet() = default;
+
+    /// Create a set that contains `items`.
+    EnumSet(std::initializer_list<Enum> items) {
+        for (const Enum item : items) {
+            insert(item);
+        }
+    }
+
+    /// Return a set that contains every item of `Enum`.
+    static EnumSet all() {
+        EnumSet result;
+        for (std::size_t i = 0; i < universe_size; ++i) {
+            result.m_words[i / word_bits] |= word_type{1} << (i % word_bits);
+        }
+        return result;
+    }
+
+    /// Return `true` if `item` is in the set.
+    constexpr bool contains(Enum item) const {
+        const std::size_t i = to_index(item);
+        return (m_words[i / word_bits] >> (i % word_bits)) & 1;
+    }
+
+    /// Add `item` to the set.
+    void insert(Enum item) {
+        const std::size_t i = to_index(item);
+        m_words[i / word_bits] |= word_type{1} << (i % word_bits);
+    }
+
+    /// Remove `item` from the set.
+    void erase(Enum item) {
+        const std::size_t i = to_index(item);
+        m_words[i / word_bits] &= ~(word_type{1} << (i % word_bits));
+    }
+
+    /// Remove all items from the set.
+    void clear() { m_words.fill(0); }
+
+    /// Return the number of items in the set.
+    std::size_t size() const {
+        std::size_t result = 0;
+        for (const word_type word : m_words) {
+            result += detail::popcount(word);
+        }
+        return result;
+    }
+
+    /// Return `true` if the set contains no items.
+    bool empty() const {
+        for (const word_type word : m_words) {
+            if (word != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// Return `true` if this set and `other` have at least one item in common.
+    bool intersects(const EnumSet& other) const {
+        for (std::size_t i = 0; i < word_count; ++i) {
+            if ((m_words[i] & other.m_words[i]) != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// Return `true` if every item of this set is also in `other`.
+    bool is_subset_of(const EnumSet& other) const {
+        for (std::size_t i = 0; i < word_count; ++i) {
+            if ((m_words[i] & ~other.m_words[i]) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// Add all items of `other` to this set.
+    EnumSet& operator |=(const EnumSet& other) {
+        for (std::size_t i = 0; i < word_count; ++i) {
+            m_words[i] |= other.m_words[i];
+        }
+        return *this;
+    }
+
+    /// Remove all items from this set that are not in `other`.
+    EnumSet& operator &=(const EnumSet& other) {
+        for (std::size_t i = 0; i < word_count; ++i) {
+            m_words[i] &= other.m_words[i];
+        }
+        return *this;
+    }
+
+    friend EnumSet operator |(EnumSet lhs, const EnumSet& rhs) { return lhs |= rhs; }
+    friend EnumSet operator &(EnumSet lhs, const EnumSet& rhs) { return lhs &= rhs; }
+
+    /// Sets are equal if they contain the same items.
+    bool operator ==(const EnumSet& rhs) const { return m_words == rhs.m_words; }
+    bool operator !=(const EnumSet& rhs) const { return m_words != rhs.m_words; }
+
+    /// Iterate over the items in the set, in `enum` order.
+    const_iterator begin() const { return const_iterator{this, 0}; }
+    const_iterator end() const { return const_iterator{this, universe_size}; }
+
+    /// Return a pointer to the first word of the bitset.
+    constexpr word_type* words() { return m_words.data(); }
+    constexpr const word_type* words() const { return m_words.data(); }
+
+private:
+    /// Bit `i % 64` of word `i / 64` is set if item `i` is in the set.
+    std::array<word_type, word_count> m_words{};
+};
+
+
+/**A set of items of an `enum` that can be shared between threads.
+ *
+ * Like `EnumSet`, but every word is atomic, so that any thread may test
+ * membership while others insert or erase items. Each operation is
+ * atomic on its own; `load()` and `store()` are not atomic as a whole.
+ * Membership tests use relaxed loads and are meant for flags that are
+ * checked often and changed rarely.
+ */
+template<typename Enum>
+class AtomicEnumSet {
+public:
+    /// `Enum`.
+    using value_type = Enum;
+
+    /// The type of a single word of the bitset.
+    using word_type = std::uint64_t;
+
+    /// Number of words needed to hold one bit per item.
+    static constexpr std::size_t word_count = EnumSet<Enum>::word_count;
+
+    /// Create an empty set.
+    AtomicEnumSet() { clear(); }
+
+    /// Create a set that contains the items of `set`.
+    explicit AtomicEnumSet(const EnumSet<Enum>& set) { store(set); }
+
+    AtomicEnumSet(const AtomicEnumSet&) = delete;
+    AtomicEnumSet& operator =(const AtomicEnumSet&) = delete;
+
+    /// Return `true` if `item` is in the set.
+    bool contains(Enum item, std::memory_order order = std::memory_order_relaxed) const {
+        const std::size_t i = to_index(item);
+        return (m_words[i / 64].load(order) >> (i % 64)) & 1;
+    }
+
+    /// Add `item` to the set.
+    void insert(Enum item) {
+        const std::size_t i = to_index(item);
+        m_words[i / 64].fetch_or(word_type{1} << (i % 64));
+    }
+
+    /// Remove `item` from the set.
+    void erase(Enum item) {
+        const std::size_t i = to_index(item);
+        m_words[i / 64].fetch_and(~(word_type{1} << (i % 64)));
+    }
+
+    /// Remove all items from the set.
+    void clear() {
+        for (std::atomic<word_type>& word : m_words) {
+            word.store(0);
+        }
+    }
+
+    /// Return a copy of the set, one word at a time.
+    EnumSet<Enum> load() const {
+        EnumSet<Enum> result;
+        for (std::size_t i = 0; i < word_count; ++i) {
+            result.words()[i] = m_words[i].load();
+        }
+        return result;
+    }
+
+    /// Replace the set's items with those of `set`, one word at a time.
+    void store(const EnumSet<Enum>& set) {
+        for (std::size_t i = 0; i < word_count; ++i) {
+            m_words[i].store(set.words()[i]);
+        }
+    }
+
+private:
+    /// Bit `i % 64` of word `i / 64` is set if item `i` is in the set.
+    std::array<std::atomic<word_type>, word_count> m_words;
+};
+
+
+/**A growable column of `enum` items, bit-packed to the width of the range.
+ *
+ * Each item is stored as its position between `BEGIN` and `END`, using
+ * just enough bits to tell all positions apart. Items may straddle
+ * word boundaries. Use `unpack()` to decode runs of items in bulk.
+ */
+template<typename Enum>
+class PackedColumn {
+public:
+    /// `Enum`.
+    using value_type = Enum;
+
+    /// The type of a single word of storage.
+    using word_type = std::uint64_t;
+
+    /// Number of bits per stored item.
+    static constexpr unsigned bits = [] {
+        unsigned result = 1;
+        while ((std::size_t{1} << result) < Enumerate<Enum>::size()) {
+            ++result;
+        }
+        return result;
+    }();
+
+    /// Create an empty column.
+    PackedColumn() = default;
+
+    /// Create a column that holds a copy of the `size` items at `data`.
+    PackedColumn(const Enum* data, std::size_t size) {
+        reserve(size);
+        for (std::size_t i = 0; i < size; ++i) {
+            push_back(data[i]);
+        }
+    }
+
+    /// Return the number of items.
+    std::size_t size() const { return m_size; }
+
+    /// Return `true` if the column holds no items.
+    bool empty() const { return m_size == 0; }
+
+    /// Make room for `size` items without reallocating.
+    void reserve(std::size_t size) { m_words.reserve(words_for(size)); }
+
+    /// Append `item`.
+    void push_back(Enum item) {
+        m_words.resize(words_for(m_size + 1), 0);
+        set(m_size++, item);
+    }
+
+    /// Replace the item at position `i`.
+    void set(std::size_t i, Enum item) {
+        const word_type value = to_index(item);
+        const std::size_t bit = i * bits;
+        const std::size_t word = bit / 64;
+        const unsigned shift = bit % 64;
+        m_words[word] = (m_words[word] & ~(mask << shift)) | (value << shift);
+        if (shift + bits > 64) {
+            const unsigned spill = 64 - shift;
+            m_words[word + 1] =
+                (m_words[word + 1] & ~(mask >> spill)) | (value >> spill);
+        }
+    }
+
+    /// Return the item at position `i`.
+    Enum operator [](std::size_t i) const {
+        const std::size_t bit = i * bits;
+        const std::size_t word = bit / 64;
+        const unsigned shift = bit % 64;
+        word_type value = m_words[word] >> shift;
+        if (shift + bits > 64) {
+            value |= m_words[word + 1] << (64 - shift);
+        }
+        return from_index<Enum>(static_cast<std::size_t>(value & mask));
+    }
+
+    /**Decode the `count` items starting at position `first` into `out`.
+     *
+     * If `bits` divides 64, no item straddles two words, and each word
+     * is decoded by a loop of fixed length that the compiler unrolls
+     * and vectorizes. Otherwise, the words are streamed through a bit
+     * buffer, so that each word is loaded once.
+     */
+    void unpack(std::size_t first, std::size_t count, Enum* out) const {
+        if constexpr (64 % bits == 0) {
+            constexpr std::size_t per_word = 64 / bits;
+            std::size_t i = 0;
+            for (; i < count && (first + i) % per_word != 0; ++i) {
+                out[i] = (*this)[first + i];
+            }
+            for (; i + per_word <= count; i += per_word) {
+                const word_type word = m_words[(first + i) / per_word];
+                for (std::size_t k = 0; k < per_word; ++k) {
+                    const word_type value = (word >> (k * bits)) & mask;
+                    out[i + k] = from_index<Enum>(static_cast<std::size_t>(value));
+                }
+            }
+            for (; i < count; ++i) {
+                out[i] = (*this)[first + i];
+            }
+        } else {
+            if (count == 0) {
+                return;
+            }
+            // `buffer` holds the next `available` undecoded bits.
+            std::size_t word = first * bits / 64;
+            const unsigned shift = first * bits % 64;
+            word_type buffer = m_words[word] >> shift;
+            unsigned available = 64 - shift;
+            for (std::size_t i = 0; i < count; ++i) {
+                word_type value = buffer;
+                if (available >= bits) {
+                    buffer >>= bits;
+                    available -= bits;
+                } else {
+                    // The item continues in the next word.
+                    const word_type next = m_words[++word];
+                    value |= next << available;
+                    const unsigned used = bits - available;
+                    buffer = next >> used;
+                    available = 64 - used;
+                }
+                out[i] = from_index<Enum>(static_cast<std::size_t>(value & mask));
+            }
+        }
+    }
+
+    /// Return a pointer to the first word of storage.
+    const word_type* words() const { return m_words.data(); }
+
+private:
+    /// Mask of the low `bits` bits.
+    static constexpr word_type mask = bits == 64 ? ~word_type{0} : (word_type{1} << bits) - 1;
+
+    /// Return the number of words needed for `size` items.
+    static std::size_t words_for(std::size_t size) {
+        return (size * bits + 63) / 64;
+    }
+
+    /// The packed items.
+    std::vector<word_type> m_words;
+
+    /// Number of items.
+    std::size_t m_size = 0;
+};
+
+}
+
+#endif // ENUMERATE_CONTAINERS_HPP
@@ -0,0 +1,280 @@
+/*
+ * enumerate/crosstab.hpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Nico Madysa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENUMERATE_CROSSTAB_HPP
+#define ENUMERATE_CROSSTAB_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "../enumerate.hpp"
+#include "reduce.hpp"
+
+
+namespace enumerate {
+
+/**A dense contingency table with one cell per pair of items.
+ *
+ * Cells are stored row by row: the cell of `(a, b)` is at the
+ * mixed-radix position `to_index(a) * cols + to_index(b)`. The table
+ * lives on the heap, since its size grows with the product of both
+ * `enum`s.
+ */
+template<typename Enum1, typename Enum2, typename T = std::uint64_t>
+class CrossTab {
+public:
+    /// Number of rows, i.e. the number of items in `Enum1`.
+    static constexpr std::size_t rows = Enumerate<Enum1>::size();
+
+    /// Number of columns, i.e. the number of items in `Enum2`.
+    static constexpr std::size_t cols = Enumerate<Enum2>::size();
+
+    /// Create a table of value-initialized cells.
+    CrossTab() : m_cells(rows * cols) {}
+
+    /// Return the cell of `(a, b)`, unchecked.
+    T& operator ()(Enum1 a, Enum2 b) { return m_cells[to_index(a) * cols + to_index(b)]; }
+
+    /// Return the cell of `(a, b)`, unchecked.
+    const T& operator ()(Enum1 a, Enum2 b) const {
+        return m_cells[to_index(a) * cols + to_index(b)];
+    }
+
+    /// Return the cell of `(a, b)`.
+    /// \throws std::out_of_range if either item is not between `BEGIN` and `END`.
+    const T& at(Enum1 a, Enum2 b) const {
+        if (to_index(a) >= rows || to_index(b) >= cols) {
+            throw std::out_of_range("enumerate::CrossTab::at");
+        }
+        return (*this)(a, b);
+    }
+
+    /// Return the `cols` cells of the row of `a`, unchecked.
+    const T* row(Enum1 a) const { return m_cells.data() + to_index(a) * cols; }
+
+    /// Return the sum of the row of `a`.
+    T row_total(Enum1 a) const {
+        T result{};
+        for (std::size_t j = 0; j < cols; ++j) {
+            result += row(a)[j];
+        }
+        return result;
+    }
+
+    /// Return the sum of the column of `b`.
+    T col_total(Enum2 b) const {
+        T result{};
+        for (std::size_t i = 0; i < rows; ++i) {
+            result += m_cells[i * cols + to_index(b)];
+        }
+        return result;
+    }
+
+    /// Add every cell of `other` to the same cell of this table.
+    CrossTab& operator +=(const CrossTab& other) {
+        for (std::size_t i = 0; i < m_cells.size(); ++i) {
+            m_cells[i] += other.m_cells[i];
+        }
+        return *this;
+    }
+
+    /// Return a pointer to the first cell.
+    T* data() { return m_cells.data(); }
+    const T* data() const { return m_cells.data(); }
+
+    /// Return the number of cells.
+    static constexpr std::size_t size() { return rows * cols; }
+
+private:
+    std::vector<T> m_cells;
+};
+
+
+namespace detail {
+
+/// Smallest number of rows worth a thread of its own.
+constexpr std::size_t crosstab_rows_per_thread = std::size_t{1} << 16;
+
+/**Add `weight(i)` to the cell of every row `i` in `[begin, end)` of `out`.
+ *
+ * Consecutive rows often hit the same cell, and each increment would
+ * then wait for the previous one to be stored. If the tables are small
+ * enough to stay in cache, rows are spread round-robin over four
+ * sub-tables that are summed at the end, so that neighbouring
+ * increments are independent.
+ *
+ * \throws std::out_of_range if an item is not between `BEGIN` and `END`.
+ */
+template<typename Enum1, typename Enum2, typename T, typename Weight>
+void crosstab_rows(const Enum1* col1, const Enum2* col2, const Weight& weight,
+                   std::size_t begin, std::size_t end, T* out) {
+    constexpr std::size_t rows = Enumerate<Enum1>::size();
+    constexpr std::size_t cols = Enumerate<Enum2>::size();
+    constexpr std::size_t cells = rows * cols;
+    constexpr std::size_t ways = 4 * cells * sizeof(T) <= (std::size_t{256} << 10) ? 4 : 1;
+    auto key = [&](std::size_t i) {
+        const std::size_t a = to_index(col1[i]);
+        const std::size_t b = to_index(col2[i]);
+        if (a >= rows || b >= cols) {
+            throw std::out_of_range("enumerate::crosstab");
+        }
+        return a * cols + b;
+    };
+    if (ways == 1) {
+        for (std::size_t i = begin; i < end; ++i) {
+            out[key(i)] += weight(i);
+        }
+        return;
+    }
+    std::vector<T> tables(ways * cells);
+    std::size_t i = begin;
+    for (; i + ways <= end; i += ways) {
+        for (std::size_t k = 0; k < ways; ++k) {
+            tables[k * cells + key(i + k)] += weight(i + k);
+        }
+    }
+    for (; i < end; ++i) {
+        tables[key(i)] += weight(i);
+    }
+    for (std::size_t k = 0; k < ways; ++k) {
+        for (std::size_t c = 0; c < cells; ++c) {
+            out[c] += tables[k * cells + c];
+        }
+    }
+}
+
+
+/// Call `f(t)` for every `t` in `[0, threads)`, each on its own thread.
+/// The first exception thrown by any call is rethrown after all finish.
+template<typename F>
+void run_on_threads(std::size_t threads, const F& f) {
+    std::exception_ptr error;
+    std::atomic<bool> failed{false};
+    auto work = [&](std::size_t t) {
+        try {
+            f(t);
+        } catch (...) {
+            if (!failed.exchange(true)) {
+                error = std::current_exception();
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (std::size_t t = 1; t < threads; ++t) {
+        workers.emplace_back(work, t);
+    }
+    work(0);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+
+/// Cross-tabulate `size` rows on up to `threads` threads.
+template<typename Enum1, typename Enum2, typename T, typename Weight>
+CrossTab<Enum1, Enum2, T> crosstab(const Enum1* col1, const Enum2* col2, const Weight& weight,
+                                   std::size_t size, std::size_t threads) {
+    constexpr std::size_t cells = CrossTab<Enum1, Enum2, T>::size();
+    CrossTab<Enum1, Enum2, T> result;
+    threads = std::min(resolve_threads(threads),
+                       std::max<std::size_t>(size / crosstab_rows_per_thread, 1));
+    if (threads == 1) {
+        crosstab_rows(col1, col2, weight, 0, size, result.data());
+        return result;
+    }
+    // Each thread counts a slice of the rows into its own table; then
+    // each thread sums a slice of the cells over all tables.
+    std::vector<T> partial(threads * cells);
+    run_on_threads(threads, [&](std::size_t t) {
+        crosstab_rows(col1, col2, weight, size * t / threads, size * (t + 1) / threads,
+                      partial.data() + t * cells);
+    });
+    run_on_threads(threads, [&](std::size_t t) {
+        for (std::size_t c = cells * t / threads; c < cells * (t + 1) / threads; ++c) {
+            T sum{};
+            for (std::size_t table = 0; table < threads; ++table) {
+                sum += partial[table * cells + c];
+            }
+            result.data()[c] = sum;
+        }
+    });
+    return result;
+}
+
+}
+
+
+/**Count how often each pair of items occurs in two parallel columns.
+ *
+ * Row `i` contributes to the cell of `(col1[i], col2[i])`. With
+ * `threads` other than one, the rows are split among that many threads
+ * (zero uses every hardware thread), whose tables are merged in
+ * parallel; small inputs always use a single thread.
+ *
+ * ```
+ * const auto table = crosstab(regions.data(), products.data(), regions.size());
+ * const std::uint64_t sales = table(Region::North, Product::Tea);
+ * ```
+ *
+ * \throws std::out_of_range if an item is not between `BEGIN` and `END`.
+ */
+template<typename Enum1, typename Enum2>
+CrossTab<Enum1, Enum2> crosstab(const Enum1* col1, const Enum2* col2, std::size_t size,
+                                std::size_t threads = 1) {
+    auto one = [](std::size_t) { return std::uint64_t{1}; };
+    return detail::crosstab<Enum1, Enum2, std::uint64_t>(col1, col2, one, size, threads);
+}
+
+
+/**Sum `weights[i]` per pair of items in two parallel columns.
+ *
+ * This is `crosstab()` with `weights[i]` in place of one. Floating-point
+ * sums depend on how the rows are split and may differ in their last
+ * bits between different numbers of threads.
+ *
+ * \throws std::out_of_range if an item is not between `BEGIN` and `END`.
+ */
+template<typename Enum1, typename Enum2, typename W>
+CrossTab<Enum1, Enum2, W> weighted_crosstab(const Enum1* col1, const Enum2* col2, const W* weights,
+                                            std::size_t size, std::size_t threads = 1) {
+    auto weight = [weights](std::size_t i) { return weights[i]; };
+    return detail::crosstab<Enum1, Enum2, W>(col1, col2, weight, size, threads);
+}
+
+}
+
+#endif // ENUMERATE_CROSSTAB_HPP
@@ -0,0 +1,290 @@
+/*
+ * enumerate/delta.hpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Nico Madysa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENUMERATE_DELTA_HPP
+#define ENUMERATE_DELTA_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "../enumerate.hpp"
+#include "containers.hpp"
+#include "names.hpp"
+#include "serialize.hpp"
+
+
+namespace enumerate {
+
+namespace detail {
+
+/// Append `value` to `out` as an LEB128 varint.
+inline void write_varint(std::vector<std::uint8_t>& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<std::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+/// Read an LEB128 varint at `pos` and advance `pos` past it.
+/// \throws SerializationError if the varint runs past `end` or does not
+///         fit in 64 bits.
+inline std::uint64_t read_varint(const std::uint8_t*& pos, const std::uint8_t* end) {
+    std::uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos == end) {
+            throw SerializationError("enumerate: truncated varint");
+        }
+        const std::uint8_t byte = *pos++;
+        // The tenth byte holds only bit 63; anything more would be lost.
+        if (shift == 63 && (byte & 0x7e) != 0) {
+            throw SerializationError("enumerate: overlong varint");
+        }
+        value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    throw SerializationError("enumerate: overlong varint");
+}
+
+/// Map a signed difference to an unsigned one with small magnitudes first.
+constexpr std::uint64_t zigzag_encode(std::uint64_t difference) {
+    return (difference << 1) ^ (0 - (difference >> 63));
+}
+
+/// Invert `zigzag_encode()`.
+constexpr std::uint64_t zigzag_decode(std::uint64_t value) {
+    return (value >> 1) ^ (0 - (value & 1));
+}
+
+/// Append the eight bytes of `value` to `out`, least significant first.
+inline void write_u64(std::vector<std::uint8_t>& out, std::uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+    }
+}
+
+/// Read eight bytes, least significant first, and advance `pos`.
+inline std::uint64_t read_u64(const std::uint8_t*& pos, const std::uint8_t* end) {
+    if (end - pos < 8) {
+        throw SerializationError("enumerate: truncated delta header");
+    }
+    std::uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value |= static_cast<std::uint64_t>(*pos++) << (8 * i);
+    }
+    return value;
+}
+
+}
+
+
+/**Flags in the first byte of an encoded delta.
+ *
+ * A keyframe carries absolute values rather than differences. It is
+ * applied to a zeroed state, so a receiver can join at any keyframe.
+ */
+enum class DeltaFlags : std::uint8_t {
+    None = 0,
+    Keyframe = 1,
+};
+
+
+/**Encode changes to a dense array of per-item counters.
+ *
+ * Each call to `encode()` compares the current counters against those
+ * of the previous call and emits only the keys that changed. The wire
+ * format is
+ * - one byte of `DeltaFlags`,
+ * - the `enum`'s `fingerprint()` as eight little-endian bytes,
+ * - a varint sequence number,
+ * - a bitmap with one bit per item, set if the item changed,
+ * - one zigzag varint per set bit holding the wrapped difference.
+ *
+ * Differences wrap around, so counters that were reset still round-trip
+ * exactly.
+ */
+template<typename Enum, typename Counter = std::uint64_t>
+class DeltaEncoder {
+    static_assert(std::is_unsigned<Counter>::value,
+                  "counters must be of unsigned integral type");
+
+public:
+    /// The counter array that is being replicated.
+    using map_type = EnumMap<Enum, Counter>;
+
+    /// Number of bytes in the change bitmap.
+    static constexpr std::size_t bitmap_size = (map_type::static_size + 7) / 8;
+
+    /**Append the changes since the previous call to `out`.
+     *
+     * Afterwards, `current` becomes the baseline for the next call.
+     */
+    void encode(const map_type& current, std::vector<std::uint8_t>& out) {
+        encode(current, m_baseline, DeltaFlags::None, out);
+    }
+
+    /// Append a keyframe that carries all values of `current` to `out`.
+    void encode_keyframe(const map_type& current, std::vector<std::uint8_t>& out) {
+        encode(current, map_type{}, DeltaFlags::Keyframe, out);
+    }
+
+    /// Return the values that the next delta is relative to.
+    const map_type& baseline() const { return m_baseline; }
+
+    /// Return the sequence number of the next delta.
+    std::uint64_t sequence() const { return m_sequence; }
+
+private:
+    void encode(
+        const map_type& current, const map_type& previous,
+        DeltaFlags flags, std::vector<std::uint8_t>& out
+    ) {
+        out.push_back(static_cast<std::uint8_t>(flags));
+        detail::write_u64(out, fingerprint<Enum>());
+        detail::write_varint(out, m_sequence++);
+        const std::size_t bitmap_pos = out.size();
+        out.resize(out.size() + bitmap_size, 0);
+        for (std::size_t i = 0; i < map_type::static_size; ++i) {
+            const Counter difference =
+                static_cast<Counter>(current.data()[i] - previous.data()[i]);
+            if (difference != 0) {
+                out[bitmap_pos + i / 8] |= static_cast<std::uint8_t>(1u << (i % 8));
+                detail::write_varint(out, detail::zigzag_encode(
+                    sign_extend(difference)));
+            }
+        }
+        m_baseline = current;
+    }
+
+    /// Widen `difference` as if it was a signed `Counter`.
+    static std::uint64_t sign_extend(Counter difference) {
+        using signed_type = typename std::make_signed<Counter>::type;
+        return static_cast<std::uint64_t>(
+            static_cast<std::int64_t>(static_cast<signed_type>(difference)));
+    }
+
+    /// The counters as of the previous call.
+    map_type m_baseline{};
+
+    /// Sequence number of the next delta.
+    std::uint64_t m_sequence = 0;
+};
+
+
+/**Rebuild a counter array from the deltas of a `DeltaEncoder`.
+ *
+ * Deltas must be applied in order, starting with the encoder's first
+ * delta or any keyframe. A missing delta is detected by its sequence
+ * number; the decoder then refuses everything but a keyframe.
+ */
+template<typename Enum, typename Counter = std::uint64_t>
+class DeltaDecoder {
+public:
+    /// The counter array that is being replicated.
+    using map_type = EnumMap<Enum, Counter>;
+
+    /**Apply the delta at the start of `data` and return its size in bytes.
+     *
+     * \throws SerializationError if the delta is corrupt, belongs to
+     *         another `enum` layout, or does not follow the previous one.
+     *         The state is left unchanged in that case.
+     */
+    std::size_t apply(const std::uint8_t* data, std::size_t size) {
+        const std::uint8_t* pos = data;
+        const std::uint8_t* const end = data + size;
+        if (pos == end) {
+            throw SerializationError("enumerate: empty delta");
+        }
+        const auto flags = *pos++;
+        const bool keyframe =
+            (flags & static_cast<std::uint8_t>(DeltaFlags::Keyframe)) != 0;
+        if (detail::read_u64(pos, end) != fingerprint<Enum>()) {
+            throw SerializationError("enumerate: delta of another enum layout");
+        }
+        const std::uint64_t sequence = detail::read_varint(pos, end);
+        if (!keyframe && sequence != m_sequence) {
+            throw SerializationError("enumerate: delta out of sequence");
+        }
+        constexpr std::size_t bitmap_size = (map_type::static_size + 7) / 8;
+        if (static_cast<std::size_t>(end - pos) < bitmap_size) {
+            throw SerializationError("enumerate: truncated delta bitmap");
+        }
+        const std::uint8_t* const bitmap = pos;
+        pos += bitmap_size;
+        // Check the whole delta before touching the state, then apply it
+        // in place; the second pass cannot fail.
+        const std::uint8_t* const differences = pos;
+        for_each_difference(bitmap, pos, end, [](std::size_t, std::uint64_t) {});
+        if (keyframe) {
+            std::fill_n(m_state.data(), map_type::static_size, Counter{});
+        }
+        pos = differences;
+        for_each_difference(bitmap, pos, end, [this](std::size_t i, std::uint64_t difference) {
+            m_state.data()[i] = static_cast<Counter>(
+                m_state.data()[i] + static_cast<Counter>(difference));
+        });
+        m_sequence = sequence + 1;
+        return static_cast<std::size_t>(pos - data);
+    }
+
+    /// Return the counters as of the last applied delta.
+    const map_type& state() const { return m_state; }
+
+private:
+    /// Call `f(i, difference)` for every counter `i` marked in `bitmap`,
+    /// reading the differences from `pos` onwards.
+    template<typename F>
+    static void for_each_difference(const std::uint8_t* bitmap, const std::uint8_t*& pos,
+                                    const std::uint8_t* end, F f) {
+        constexpr std::size_t bitmap_size = (map_type::static_size + 7) / 8;
+        for (std::size_t byte = 0; byte < bitmap_size; ++byte) {
+            for (unsigned bits = bitmap[byte]; bits != 0; bits &= bits - 1) {
+                const std::size_t i = byte * 8 + detail::count_trailing_zeros(bits);
+                if (i >= map_type::static_size) {
+                    throw SerializationError("enumerate: delta bitmap out of range");
+                }
+                f(i, detail::zigzag_decode(detail::read_varint(pos, end)));
+            }
+        }
+    }
+
+    /// The replicated counters.
+    map_type m_state{};
+
+    /// Sequence number of the next expected delta.
+    std::uint64_t m_sequence = 0;
+};
+
+}
+
+#endif // ENUMERATE_DELTA_HPP
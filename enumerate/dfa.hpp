@@ -0,0 +1,213 @@
+/*
+ * enumerate/dfa.hpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Nico Madysa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENUMERATE_DFA_HPP
+#define ENUMERATE_DFA_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "../enumerate.hpp"
+#include "filter.hpp"
+
+
+namespace enumerate {
+
+/**A deterministic finite automaton over bytes whose states are an `enum`.
+ *
+ * Running an automaton the usual way is a chain of dependent loads,
+ * one per byte, because each byte's row can only be looked up once the
+ * previous state is known. With at most 16 states, this class stores
+ * the transitions of each byte as a 16-byte vector that maps every
+ * state to its successor. Two such vectors compose with a single byte
+ * shuffle, so a chunk of input can be reduced to its transition vector
+ * without knowing the state it starts in.
+ *
+ * `run()` splits the input into several chunks, composes their
+ * transition vectors side by side, which keeps multiple shuffles in
+ * flight, and then composes the chunk vectors in order. The state only
+ * enters at the very end. Without SSSE3, `run()` falls back to the
+ * usual serial walk.
+ *
+ * ```
+ * enum class Json { BEGIN, Text = BEGIN, String, Escape, END };
+ * ShuffleDfa<Json> dfa{Json::Text};
+ * dfa.set(Json::Text, '"', Json::String);
+ * dfa.set_all(Json::String, Json::String);
+ * dfa.set(Json::String, '"', Json::Text);
+ * dfa.set(Json::String, '\\', Json::Escape);
+ * dfa.set_all(Json::Escape, Json::String);
+ * const Json end = dfa.run(Json::Text, data, size);
+ * ```
+ */
+template<typename State>
+class ShuffleDfa {
+public:
+    /// Number of states, i.e. the number of items in `State`.
+    static constexpr std::size_t state_count = Enumerate<State>::size();
+
+    static_assert(state_count > 0 && state_count <= 16,
+                  "ShuffleDfa supports between 1 and 16 states");
+
+    /// The effect of a stretch of input: the state it ends in, per start state.
+    using summary_type = std::array<std::uint8_t, 16>;
+
+    /// Create an automaton in which every byte leads to `target`.
+    explicit ShuffleDfa(State target = State::BEGIN) {
+        for (std::size_t byte = 0; byte < 256; ++byte) {
+            for (std::size_t state = 0; state < 16; ++state) {
+                // States beyond `END` map to themselves, which keeps
+                // every shuffle index below 16.
+                m_table[byte][state] = static_cast<std::uint8_t>(
+                    state < state_count ? to_index(target) : state);
+            }
+        }
+    }
+
+    /// Let `byte` lead from `from` to `to`.
+    void set(State from, unsigned char byte, State to) {
+        m_table[byte][to_index(from)] = static_cast<std::uint8_t>(to_index(to));
+    }
+
+    /// Let every byte in `[first, last]` lead from `from` to `to`.
+    void set(State from, unsigned char first, unsigned char last, State to) {
+        for (std::size_t byte = first; byte <= last; ++byte) {
+            set(from, static_cast<unsigned char>(byte), to);
+        }
+    }
+
+    /// Let every byte lead from `from` to `to`.
+    void set_all(State from, State to) { set(from, 0, 255, to); }
+
+    /// Return the state that `byte` leads to from `from`.
+    State next(State from, unsigned char byte) const {
+        return from_index<State>(m_table[byte][to_index(from)]);
+    }
+
+    /// Return the state reached from `start` after `size` bytes at `data`.
+    State run(State start, const void* data, std::size_t size) const {
+#ifdef ENUMERATE_HAVE_SSSE3
+        if (size >= 4 * lanes) {
+            return from_index<State>(summarize(data, size)[to_index(start)]);
+        }
+#endif
+        return run_serial(start, data, size);
+    }
+
+    /// Return the state reached from `start`, one dependent lookup per byte.
+    State run_serial(State start, const void* data, std::size_t size) const {
+        const auto* bytes = static_cast<const unsigned char*>(data);
+        std::size_t state = to_index(start);
+        for (std::size_t i = 0; i < size; ++i) {
+            state = m_table[bytes[i]][state];
+        }
+        return from_index<State>(state);
+    }
+
+    /**Return the effect of `size` bytes at `data`, for any start state.
+     *
+     * Summaries of consecutive chunks can be computed independently,
+     * e.g. on different threads, and joined with `then()`.
+     */
+    summary_type summarize(const void* data, std::size_t size) const {
+        const auto* bytes = static_cast<const unsigned char*>(data);
+#ifdef ENUMERATE_HAVE_SSSE3
+        // Each lane composes one contiguous chunk; lane `k` covers
+        // `[k * chunk, (k + 1) * chunk)` and the rest follows lane 7.
+        const std::size_t chunk = size / lanes;
+        __m128i acc[lanes];
+        for (__m128i& a : acc) {
+            a = identity();
+        }
+        for (std::size_t i = 0; i < chunk; ++i) {
+            for (std::size_t k = 0; k < lanes; ++k) {
+                acc[k] = _mm_shuffle_epi8(row(bytes[k * chunk + i]), acc[k]);
+            }
+        }
+        __m128i total = acc[0];
+        for (std::size_t k = 1; k < lanes; ++k) {
+            total = _mm_shuffle_epi8(acc[k], total);
+        }
+        for (std::size_t i = lanes * chunk; i < size; ++i) {
+            total = _mm_shuffle_epi8(row(bytes[i]), total);
+        }
+        summary_type result;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(result.data()), total);
+        return result;
+#else
+        summary_type result;
+        for (std::size_t state = 0; state < 16; ++state) {
+            result[state] = static_cast<std::uint8_t>(state);
+        }
+        for (std::size_t i = 0; i < size; ++i) {
+            for (std::uint8_t& state : result) {
+                state = m_table[bytes[i]][state];
+            }
+        }
+        return result;
+#endif
+    }
+
+    /// Return the effect of the input of `first` followed by that of `second`.
+    static summary_type then(const summary_type& first, const summary_type& second) {
+        summary_type result;
+        for (std::size_t state = 0; state < 16; ++state) {
+            result[state] = second[first[state]];
+        }
+        return result;
+    }
+
+    /// Return the state that `summary` leads to from `start`.
+    static State apply(const summary_type& summary, State start) {
+        return from_index<State>(summary[to_index(start)]);
+    }
+
+private:
+    /// Number of chunks that `summarize()` composes side by side.
+    static constexpr std::size_t lanes = 8;
+
+#ifdef ENUMERATE_HAVE_SSSE3
+    /// Return the transitions of `byte` as a vector.
+    __m128i row(unsigned char byte) const {
+        return _mm_load_si128(reinterpret_cast<const __m128i*>(m_table[byte]));
+    }
+
+    /// Return the transitions that keep every state.
+    static __m128i identity() {
+        return _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    }
+#endif
+
+    /// `m_table[byte][state]` is the successor of `state` on `byte`.
+    alignas(16) std::uint8_t m_table[256][16];
+};
+
+}
+
+#endif // ENUMERATE_DFA_HPP
@@ -0,0 +1,420 @@
+/*
+ * enumerate/entropy.hpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Nico Madysa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENUMERATE_ENTROPY_HPP
+#define ENUMERATE_ENTROPY_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "../enumerate.hpp"
+#include "containers.hpp"
+#include "delta.hpp"
+#include "names.hpp"
+#include "serialize.hpp"
+
+
+namespace enumerate {
+
+/// Count how often each item occurs among the `size` items at `data`.
+/// \throws std::out_of_range if an item is not between `BEGIN` and `END`.
+template<typename Enum>
+EnumMap<Enum, std::uint64_t> histogram(const Enum* data, std::size_t size) {
+    EnumMap<Enum, std::uint64_t> result;
+    for (std::size_t i = 0; i < size; ++i) {
+        result.at(data[i]) += 1;
+    }
+    return result;
+}
+
+
+/**A static model of item frequencies for rANS coding.
+ *
+ * The frequencies of a histogram are scaled so that they sum to
+ * `2^scale_bits()`; every item that occurs at least once keeps a
+ * frequency of at least one. Decoding looks symbols up in a table
+ * with one entry per `2^-scale_bits()` of probability mass.
+ */
+template<typename Enum>
+class RansModel {
+public:
+    /// Number of items, i.e. the size of the alphabet.
+    static constexpr std::size_t count = Enumerate<Enum>::size();
+
+    /// The largest supported `scale_bits()`.
+    static constexpr unsigned max_scale_bits = 16;
+
+    /// Create an empty model, which cannot code anything.
+    RansModel() = default;
+
+    /**Build a model from the item counts in `counts`.
+     *
+     * \throws std::length_error if more than `2^max_scale_bits` distinct
+     *         items occur.
+     */
+    explicit RansModel(const EnumMap<Enum, std::uint64_t>& counts) {
+        std::uint64_t total = 0;
+        std::size_t used = 0;
+        for (const std::uint64_t c : counts) {
+            total += c;
+            used += c != 0;
+        }
+        m_scale_bits = 12;
+        while ((std::size_t{1} << m_scale_bits) < 4 * used && m_scale_bits < max_scale_bits) {
+            ++m_scale_bits;
+        }
+        if (used > (std::size_t{1} << m_scale_bits)) {
+            throw std::length_error("enumerate: too many distinct items for rANS");
+        }
+        m_freq.assign(count, 0);
+        if (total == 0) {
+            build_tables();
+            return;
+        }
+        const std::uint32_t scale = std::uint32_t{1} << m_scale_bits;
+        std::uint32_t sum = 0;
+        std::size_t largest = 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            const std::uint64_t c = counts.data()[i];
+            if (c == 0) {
+                continue;
+            }
+            const auto f = static_cast<std::uint32_t>(
+                std::max<std::uint64_t>(1, static_cast<std::uint64_t>(
+                    static_cast<double>(c) * scale / static_cast<double>(total))));
+            m_freq[i] = f;
+            sum += f;
+            if (m_freq[i] > m_freq[largest]) {
+                largest = i;
+            }
+        }
+        // Rounding leaves the sum slightly off; settle the difference
+        // with the most frequent items, which suffer the least from it.
+        while (sum > scale) {
+            std::size_t i = largest;
+            for (std::size_t j = 0; j < count; ++j) {
+                if (m_freq[j] > m_freq[i]) {
+                    i = j;
+                }
+            }
+            const std::uint32_t take = std::min(sum - scale, m_freq[i] - 1);
+            m_freq[i] -= take;
+            sum -= take;
+            largest = i;
+        }
+        m_freq[largest] += scale - sum;
+        build_tables();
+    }
+
+    /// Return the number of bits of probability precision.
+    unsigned scale_bits() const { return m_scale_bits; }
+
+    /// Return the scaled frequency of the item at position `index`.
+    std::uint32_t frequency(std::size_t index) const { return m_freq[index]; }
+
+    /// Return the summed frequency of all items before position `index`.
+    std::uint32_t cumulative(std::size_t index) const { return m_cum[index]; }
+
+    /// Return the position of the item that owns the probability `slot`.
+    std::size_t symbol_at(std::uint32_t slot) const { return m_symbol[slot]; }
+
+    /**Append the model to `out`.
+     *
+     * The header consists of the `enum`'s `fingerprint()`, the alphabet
+     * size and the scale as varints, followed by one varint frequency
+     * per item. Absent items cost a single byte.
+     */
+    void write(std::vector<std::uint8_t>& out) const {
+        detail::write_u64(out, fingerprint<Enum>());
+        detail::write_varint(out, count);
+        detail::write_varint(out, m_scale_bits);
+        for (const std::uint32_t f : m_freq) {
+            detail::write_varint(out, f);
+        }
+    }
+
+    /**Read a model written by `write()` and advance `pos` past it.
+     *
+     * \throws SerializationError if the model is corrupt or belongs to
+     *         a different `enum` layout.
+     */
+    static RansModel read(const std::uint8_t*& pos, const std::uint8_t* end) {
+        if (detail::read_u64(pos, end) != fingerprint<Enum>()
+            || detail::read_varint(pos, end) != count) {
+            throw SerializationError("enumerate: rANS model of another enum layout");
+        }
+        RansModel model;
+        const std::uint64_t scale_bits = detail::read_varint(pos, end);
+        if (scale_bits < 1 || scale_bits > max_scale_bits) {
+            throw SerializationError("enumerate: rANS model scale out of range");
+        }
+        model.m_scale_bits = static_cast<unsigned>(scale_bits);
+        model.m_freq.resize(count);
+        std::uint64_t sum = 0;
+        for (std::uint32_t& f : model.m_freq) {
+            const std::uint64_t value = detail::read_varint(pos, end);
+            sum += value;
+            if (sum > (std::uint64_t{1} << scale_bits)) {
+                throw SerializationError("enumerate: rANS model frequencies overflow");
+            }
+            f = static_cast<std::uint32_t>(value);
+        }
+        if (sum != 0 && sum != (std::uint64_t{1} << scale_bits)) {
+            throw SerializationError("enumerate: rANS model frequencies do not add up");
+        }
+        model.build_tables();
+        return model;
+    }
+
+private:
+    void build_tables() {
+        m_cum.assign(count + 1, 0);
+        for (std::size_t i = 0; i < count; ++i) {
+            m_cum[i + 1] = m_cum[i] + m_freq[i];
+        }
+        m_symbol.assign(m_cum[count], 0);
+        for (std::size_t i = 0; i < count; ++i) {
+            std::fill(m_symbol.begin() + m_cum[i], m_symbol.begin() + m_cum[i + 1],
+                      static_cast<std::uint32_t>(i));
+        }
+    }
+
+    /// Number of bits of probability precision.
+    unsigned m_scale_bits = 12;
+
+    /// Scaled frequency per item.
+    std::vector<std::uint32_t> m_freq;
+
+    /// Prefix sums of `m_freq`, with one extra entry for the total.
+    std::vector<std::uint32_t> m_cum;
+
+    /// Item position for every probability slot.
+    std::vector<std::uint32_t> m_symbol;
+};
+
+
+namespace detail {
+
+/// Lower bound of the normalized rANS state interval.
+constexpr std::uint32_t rans_lower_bound = std::uint32_t{1} << 23;
+
+/// Number of interleaved rANS states.
+constexpr std::size_t rans_ways = 4;
+
+/**Return an upper bound on the items that `model` decodes from the
+ * states followed by `bytes` renormalization bytes.
+ *
+ * With `x = q * 2^scale_bits + slot`, decoding an item of frequency `f`
+ * yields at most `f * q + slot`, which shrinks a normalized state by a
+ * constant factor unless `f` is the whole scale. Reading a byte grows a
+ * state by less than 9 bits, so the bound is linear in `bytes`. A model
+ * with a single item codes any number of items in the states alone;
+ * its bound is infinite.
+ */
+template<typename Enum>
+double rans_max_items(const RansModel<Enum>& model, std::size_t bytes) {
+    const double scale = std::ldexp(1.0, static_cast<int>(model.scale_bits()));
+    std::uint32_t largest = 0;
+    for (std::size_t i = 0; i < RansModel<Enum>::count; ++i) {
+        largest = std::max(largest, model.frequency(i));
+    }
+    if (largest >= scale) {
+        return std::numeric_limits<double>::infinity();
+    }
+    const double shrink = 1.0 - (1.0 - largest / scale) * (1.0 - scale / rans_lower_bound);
+    const double bits_per_item = -std::log2(shrink);
+    // Each state may start out of range and take one extra item to
+    // normalize, and holds at most 9 more bits than it ends with.
+    return static_cast<double>(rans_ways) * (2.0 + 9.0 / bits_per_item)
+           + 9.0 * static_cast<double>(bytes) / bits_per_item;
+}
+
+}
+
+
+/**Encode the `size` items at `data` with a given model.
+ *
+ * The output holds the item count as a varint, then the final states
+ * of four interleaved rANS coders, then the renormalization bytes.
+ * Interleaving lets the decoder work on four independent dependency
+ * chains at once.
+ *
+ * \throws std::invalid_argument if an item has zero frequency in `model`.
+ */
+template<typename Enum>
+void rans_encode(
+    const Enum* data, std::size_t size,
+    const RansModel<Enum>& model, std::vector<std::uint8_t>& out
+) {
+    using detail::rans_ways;
+    if (size == 0) {
+        detail::write_varint(out, 0);
+        return;
+    }
+    const unsigned scale_bits = model.scale_bits();
+    // Each item emits at most `scale_bits / 8 + 1` bytes.
+    std::vector<std::uint8_t> buffer(size * (scale_bits / 8 + 1) + 4 * rans_ways);
+    std::uint8_t* const buffer_end = buffer.data() + buffer.size();
+    std::uint8_t* ptr = buffer_end;
+    std::uint32_t states[rans_ways];
+    std::fill(states, states + rans_ways, detail::rans_lower_bound);
+    for (std::size_t i = size; i-- > 0;) {
+        const std::size_t index = to_index(data[i]);
+        const std::uint32_t freq = index < RansModel<Enum>::count ? model.frequency(index) : 0;
+        if (freq == 0) {
+            throw std::invalid_argument("enumerate: item not covered by the rANS model");
+        }
+        std::uint32_t& x = states[i % rans_ways];
+        const std::uint32_t x_max = ((detail::rans_lower_bound >> scale_bits) << 8) * freq;
+        while (x >= x_max) {
+            *--ptr = static_cast<std::uint8_t>(x);
+            x >>= 8;
+        }
+        x = ((x / freq) << scale_bits) + (x % freq) + model.cumulative(index);
+    }
+    for (std::size_t way = rans_ways; way-- > 0;) {
+        ptr -= 4;
+        for (int b = 0; b < 4; ++b) {
+            ptr[b] = static_cast<std::uint8_t>(states[way] >> (8 * b));
+        }
+    }
+    detail::write_varint(out, size);
+    out.insert(out.end(), ptr, buffer_end);
+}
+
+
+/**Decode `size` items that were encoded by `rans_encode()` with `model`.
+ *
+ * `pos` must point at the item count and is advanced past the encoded
+ * stream. The items are appended to `out`.
+ *
+ * The item count is checked before any memory is allocated for it: it
+ * must not exceed what the remaining input can encode under `model`,
+ * nor `max_size`. A model with a single item encodes any number of
+ * items in a few bytes, so only `max_size` limits those.
+ *
+ * \throws SerializationError if the stream is truncated or corrupt, or
+ *         holds more than `max_size` items.
+ */
+template<typename Enum>
+void rans_decode(
+    const std::uint8_t*& pos, const std::uint8_t* end,
+    const RansModel<Enum>& model, std::vector<Enum>& out,
+    std::size_t max_size = std::numeric_limits<std::size_t>::max()
+) {
+    using detail::rans_ways;
+    const std::uint64_t size = detail::read_varint(pos, end);
+    if (size == 0) {
+        return;
+    }
+    if (static_cast<std::size_t>(end - pos) < 4 * rans_ways) {
+        throw SerializationError("enumerate: truncated rANS stream");
+    }
+    const std::size_t bytes = static_cast<std::size_t>(end - pos) - 4 * rans_ways;
+    if (size > max_size || size > out.max_size() - out.size()
+        || static_cast<double>(size) > detail::rans_max_items(model, bytes)) {
+        throw SerializationError("enumerate: rANS item count exceeds the stream");
+    }
+    std::uint32_t states[rans_ways];
+    for (std::size_t way = 0; way < rans_ways; ++way) {
+        states[way] = 0;
+        for (int b = 0; b < 4; ++b) {
+            states[way] |= static_cast<std::uint32_t>(*pos++) << (8 * b);
+        }
+    }
+    const unsigned scale_bits = model.scale_bits();
+    const std::uint32_t mask = (std::uint32_t{1} << scale_bits) - 1;
+    const std::size_t first = out.size();
+    out.resize(first + static_cast<std::size_t>(size));
+    Enum* const items = out.data() + first;
+    auto decode_one = [&](std::uint32_t& x) {
+        const std::uint32_t slot = x & mask;
+        const std::size_t index = model.symbol_at(slot);
+        x = model.frequency(index) * (x >> scale_bits) + slot - model.cumulative(index);
+        while (x < detail::rans_lower_bound) {
+            if (pos == end) {
+                throw SerializationError("enumerate: truncated rANS stream");
+            }
+            x = (x << 8) | *pos++;
+        }
+        return from_index<Enum>(index);
+    };
+    if (model.cumulative(RansModel<Enum>::count) == 0) {
+        throw SerializationError("enumerate: rANS stream with an empty model");
+    }
+    std::size_t i = 0;
+    for (; i + rans_ways <= size; i += rans_ways) {
+        for (std::size_t way = 0; way < rans_ways; ++way) {
+            items[i + way] = decode_one(states[way]);
+        }
+    }
+    for (; i < size; ++i) {
+        items[i] = decode_one(states[i % rans_ways]);
+    }
+}
+
+
+/**Compress the `size` items at `data` into a self-contained buffer.
+ *
+ * The buffer holds a `RansModel` built from the items' histogram,
+ * followed by the output of `rans_encode()`.
+ */
+template<typename Enum>
+std::vector<std::uint8_t> compress(const Enum* data, std::size_t size) {
+    const RansModel<Enum> model{histogram(data, size)};
+    std::vector<std::uint8_t> out;
+    model.write(out);
+    rans_encode(data, size, model, out);
+    return out;
+}
+
+
+/// Decompress a buffer that was created by `compress()`, holding at
+/// most `max_size` items; see `rans_decode()`.
+/// \throws SerializationError if the buffer is corrupt, belongs to a
+///         different `enum` layout or holds more than `max_size` items.
+template<typename Enum>
+std::vector<Enum> decompress(const std::uint8_t* data, std::size_t size,
+                             std::size_t max_size = std::numeric_limits<std::size_t>::max()) {
+    const std::uint8_t* pos = data;
+    const std::uint8_t* const end = data + size;
+    const auto model = RansModel<Enum>::read(pos, end);
+    std::vector<Enum> out;
+    rans_decode(pos, end, model, out, max_size);
+    return out;
+}
+
+}
+
+#endif // ENUMERATE_ENTROPY_HPP
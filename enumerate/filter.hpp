@@ -0,0 +1,489 @@
+/*
+ * enumerate/filter.hpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Nico Madysa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENUMERATE_FILTER_HPP
+#define ENUMERATE_FILTER_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ENUMERATE_HAVE_SSE2 1
+#endif
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#define ENUMERATE_HAVE_SSSE3 1
+#endif
+
+#include "../enumerate.hpp"
+#include "containers.hpp"
+
+
+namespace enumerate {
+
+/**Kernels that evaluate predicates over columns of `enum` items.
+ *
+ * A column is a contiguous array of items or a `PackedColumn`. The
+ * result of a filter is a *selection bitmap*: bit `i % 64` of word
+ * `i / 64` is set if row `i` matches. Bitmaps must have room for
+ * `bitmap_words(size)` words; bits past the last row are cleared.
+ *
+ * On x86-64, the kernels compare 16 bytes of items per instruction
+ * using SSE2. With SSSE3, `column IN set` over one-byte `enum`s uses a
+ * byte-shuffle table lookup that costs the same for any set size.
+ */
+constexpr std::size_t bitmap_words(std::size_t rows) {
+    return (rows + 63) / 64;
+}
+
+
+namespace detail {
+
+/// The unsigned integer type with the same width as `Enum`.
+template<typename Enum>
+using filter_uint_t = std::conditional_t<sizeof(Enum) == 1, std::uint8_t,
+                      std::conditional_t<sizeof(Enum) == 2, std::uint16_t,
+                      std::conditional_t<sizeof(Enum) == 4, std::uint32_t,
+                                         std::uint64_t>>>;
+
+/// Return the raw bits of `item` as an unsigned integer.
+template<typename Enum>
+filter_uint_t<Enum> raw_bits(Enum item) {
+    filter_uint_t<Enum> result;
+    std::memcpy(&result, &item, sizeof(result));
+    return result;
+}
+
+/// Evaluate `match` on up to 64 rows and pack the results into a word.
+template<typename Enum, typename Match>
+std::uint64_t match_scalar(const Enum* rows, std::size_t count, Match match) {
+    std::uint64_t word = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        word |= static_cast<std::uint64_t>(match(raw_bits(rows[i]))) << i;
+    }
+    return word;
+}
+
+#ifdef ENUMERATE_HAVE_SSE2
+/// Turn a vector of all-ones/all-zeros lanes of `Width` bytes into bits.
+template<std::size_t Width>
+inline unsigned lane_bits(__m128i mask) {
+    if constexpr (Width == 1) {
+        return static_cast<unsigned>(_mm_movemask_epi8(mask));
+    } else if constexpr (Width == 2) {
+        return static_cast<unsigned>(
+            _mm_movemask_epi8(_mm_packs_epi16(mask, _mm_setzero_si128())));
+    } else {
+        return static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(mask)));
+    }
+}
+
+/// Compare all lanes of `Width` bytes for equality.
+template<std::size_t Width>
+inline __m128i lanes_equal(__m128i a, __m128i b) {
+    if constexpr (Width == 1) {
+        return _mm_cmpeq_epi8(a, b);
+    } else if constexpr (Width == 2) {
+        return _mm_cmpeq_epi16(a, b);
+    } else {
+        return _mm_cmpeq_epi32(a, b);
+    }
+}
+
+/// Broadcast `value` to all lanes of `Width` bytes.
+template<std::size_t Width>
+inline __m128i broadcast(std::uint64_t value) {
+    if constexpr (Width == 1) {
+        return _mm_set1_epi8(static_cast<char>(value));
+    } else if constexpr (Width == 2) {
+        return _mm_set1_epi16(static_cast<short>(value));
+    } else {
+        return _mm_set1_epi32(static_cast<int>(value));
+    }
+}
+
+/// Evaluate the vector predicate `match` on exactly 64 rows.
+template<typename Enum, typename Match>
+inline std::uint64_t match_block_sse2(const Enum* rows, Match match) {
+    constexpr std::size_t lanes = 16 / sizeof(Enum);
+    std::uint64_t word = 0;
+    for (std::size_t i = 0; i < 64; i += lanes) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows + i));
+        word |= static_cast<std::uint64_t>(lane_bits<sizeof(Enum)>(match(v))) << i;
+    }
+    return word;
+}
+#endif
+
+/**Run a filter over `size` rows, 64 at a time.
+ *
+ * `vector_match` is used for full blocks if SIMD is available and the
+ * items are at most four bytes wide; `scalar_match` for everything else.
+ */
+template<typename Enum, typename VectorMatch, typename ScalarMatch>
+void run_filter(
+    const Enum* column, std::size_t size, std::uint64_t* bitmap,
+    VectorMatch vector_match, ScalarMatch scalar_match
+) {
+    std::size_t block = 0;
+#ifdef ENUMERATE_HAVE_SSE2
+    if constexpr (sizeof(Enum) <= 4) {
+        for (; (block + 1) * 64 <= size; ++block) {
+            bitmap[block] = match_block_sse2(column + block * 64, vector_match);
+        }
+    }
+#endif
+    static_cast<void>(vector_match);
+    for (; block * 64 < size; ++block) {
+        const std::size_t count = size - block * 64 < 64 ? size - block * 64 : 64;
+        bitmap[block] = match_scalar(column + block * 64, count, scalar_match);
+    }
+}
+
+/// Sets with at most this many items are matched by repeated comparison.
+constexpr std::size_t max_compared_items = 8;
+
+
+/// Matches rows that equal one item.
+template<typename Enum>
+class EqualFilter {
+public:
+    explicit EqualFilter(Enum value) : m_raw(raw_bits(value)) {
+#ifdef ENUMERATE_HAVE_SSE2
+        m_needle = broadcast<width>(m_raw);
+#endif
+    }
+
+    /// Mark the rows among the `size` items at `column` that match.
+    void operator ()(const Enum* column, std::size_t size, std::uint64_t* bitmap) const {
+#ifdef ENUMERATE_HAVE_SSE2
+        const __m128i needle = m_needle;
+        auto vector_match = [needle](__m128i v) { return lanes_equal<width>(v, needle); };
+#else
+        auto vector_match = 0;
+#endif
+        const auto raw = m_raw;
+        run_filter(column, size, bitmap, vector_match, [raw](decltype(raw) v) { return v == raw; });
+    }
+
+private:
+    static constexpr std::size_t width = sizeof(Enum) <= 4 ? sizeof(Enum) : 4;
+
+    filter_uint_t<Enum> m_raw;
+#ifdef ENUMERATE_HAVE_SSE2
+    __m128i m_needle;
+#endif
+};
+
+
+/**Matches rows that are in a set of items.
+ *
+ * The strategy and its vectors are chosen once, when the filter is
+ * created: small sets are matched by comparing against each of their
+ * items, large sets by a lookup in the set's bitset or, for one-byte
+ * `enum`s with SSSE3, by a byte-shuffle table lookup. The set must
+ * outlive the filter.
+ */
+template<typename Enum>
+class SetFilter {
+public:
+    explicit SetFilter(const EnumSet<Enum>& set)
+        : m_words(set.words()), m_begin(raw_bits(Enumerate<Enum>::begin_value))
+    {
+        const std::size_t members = set.size();
+        if (members == 0) {
+            m_strategy = strategy::none;
+            return;
+        }
+#ifdef ENUMERATE_HAVE_SSE2
+        if (members <= max_compared_items) {
+            m_strategy = strategy::compare;
+            for (const Enum item : set) {
+                m_needles[m_needle_count++] = broadcast<width>(raw_bits(item));
+            }
+            return;
+        }
+#ifdef ENUMERATE_HAVE_SSSE3
+        if constexpr (sizeof(Enum) == 1) {
+            // Row `v` is in the set if bit `hi % 8` of `table[hi / 8][lo]`
+            // is set, where `hi` and `lo` are the nibbles of `v - BEGIN`.
+            alignas(16) std::uint8_t low_table[16] = {};
+            alignas(16) std::uint8_t high_table[16] = {};
+            for (const Enum item : set) {
+                const std::size_t index = to_index(item);
+                std::uint8_t* table = index < 128 ? low_table : high_table;
+                table[index % 16] |= static_cast<std::uint8_t>(1u << ((index / 16) % 8));
+            }
+            m_strategy = strategy::shuffle;
+            m_low = _mm_load_si128(reinterpret_cast<const __m128i*>(low_table));
+            m_high = _mm_load_si128(reinterpret_cast<const __m128i*>(high_table));
+            return;
+        }
+#endif
+#endif
+        m_strategy = strategy::lookup;
+    }
+
+    /// Mark the rows among the `size` items at `column` that match.
+    void operator ()(const Enum* column, std::size_t size, std::uint64_t* bitmap) const {
+        const uint_type begin = m_begin;
+        const std::uint64_t* const words = m_words;
+        auto scalar_match = [begin, words](uint_type v) {
+            const std::uint64_t index = static_cast<uint_type>(v - begin);
+            // Branch-free: rows outside the range read word zero and are masked out.
+            const bool in_range = index < EnumSet<Enum>::universe_size;
+            const std::uint64_t word = words[in_range ? index / 64 : 0];
+            return in_range & static_cast<bool>((word >> (index % 64)) & 1);
+        };
+        switch (m_strategy) {
+        case strategy::none:
+            std::fill_n(bitmap, bitmap_words(size), 0);
+            return;
+#ifdef ENUMERATE_HAVE_SSE2
+        case strategy::compare: {
+            const __m128i* const needles = m_needles;
+            const std::size_t count = m_needle_count;
+            auto vector_match = [needles, count](__m128i v) {
+                __m128i result = lanes_equal<width>(v, needles[0]);
+                for (std::size_t i = 1; i < count; ++i) {
+                    result = _mm_or_si128(result, lanes_equal<width>(v, needles[i]));
+                }
+                return result;
+            };
+            run_filter(column, size, bitmap, vector_match, scalar_match);
+            return;
+        }
+#endif
+#ifdef ENUMERATE_HAVE_SSSE3
+        case strategy::shuffle:
+            if constexpr (sizeof(Enum) == 1) {
+                const __m128i low = m_low;
+                const __m128i high = m_high;
+                const __m128i bit_of = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+                                                     1, 2, 4, 8, 16, 32, 64, -128);
+                const __m128i nibble = _mm_set1_epi8(0x0f);
+                const __m128i offset = _mm_set1_epi8(static_cast<char>(begin));
+                auto vector_match = [=](__m128i v) {
+                    const __m128i index = _mm_sub_epi8(v, offset);
+                    const __m128i lo = _mm_and_si128(index, nibble);
+                    const __m128i hi = _mm_and_si128(_mm_srli_epi16(index, 4), nibble);
+                    const __m128i row_low = _mm_shuffle_epi8(low, lo);
+                    const __m128i row_high = _mm_shuffle_epi8(high, lo);
+                    // `hi >= 8` has its sign bit set after shifting left by four.
+                    const __m128i use_high =
+                        _mm_cmplt_epi8(_mm_slli_epi16(hi, 4), _mm_setzero_si128());
+                    const __m128i row = _mm_or_si128(_mm_and_si128(use_high, row_high),
+                                                     _mm_andnot_si128(use_high, row_low));
+                    const __m128i bit = _mm_shuffle_epi8(bit_of, hi);
+                    return _mm_cmpeq_epi8(_mm_and_si128(row, bit), bit);
+                };
+                run_filter(column, size, bitmap, vector_match, scalar_match);
+                return;
+            }
+            break;
+#endif
+        default:
+            break;
+        }
+        // Look every row up in the set's bitset.
+        for (std::size_t block = 0; block * 64 < size; ++block) {
+            const std::size_t count = size - block * 64 < 64 ? size - block * 64 : 64;
+            bitmap[block] = match_scalar(column + block * 64, count, scalar_match);
+        }
+    }
+
+private:
+    using uint_type = filter_uint_t<Enum>;
+
+    static constexpr std::size_t width = sizeof(Enum) <= 4 ? sizeof(Enum) : 4;
+
+    enum class strategy { none, compare, shuffle, lookup };
+
+    const std::uint64_t* m_words;
+    uint_type m_begin;
+    strategy m_strategy = strategy::lookup;
+#ifdef ENUMERATE_HAVE_SSE2
+    __m128i m_needles[max_compared_items];
+    std::size_t m_needle_count = 0;
+#endif
+#ifdef ENUMERATE_HAVE_SSSE3
+    __m128i m_low;
+    __m128i m_high;
+#endif
+};
+
+
+/// Rows of a packed column that are unpacked at a time; 8 KiB of items.
+template<typename Enum>
+constexpr std::size_t packed_block_rows = sizeof(Enum) <= 128 ? 8192 / sizeof(Enum) : 64;
+
+/**Run `filter` over `count` rows of a packed column, starting at `first`.
+ *
+ * The rows are unpacked a block at a time into a buffer that stays in
+ * the L1 cache; `first` must be a multiple of 64.
+ */
+template<typename Enum, typename Filter>
+void run_packed_filter(
+    const PackedColumn<Enum>& column, std::size_t first, std::size_t count,
+    std::uint64_t* bitmap, const Filter& filter
+) {
+    constexpr std::size_t block_rows = packed_block_rows<Enum>;
+    static_assert(block_rows % 64 == 0, "packed blocks must cover whole bitmap words");
+    Enum buffer[block_rows];
+    for (std::size_t done = 0; done < count; done += block_rows) {
+        const std::size_t rows = std::min(block_rows, count - done);
+        column.unpack(first + done, rows, buffer);
+        filter(buffer, rows, bitmap + done / 64);
+    }
+}
+
+}
+
+
+/// Mark the rows among the `size` items at `column` that equal `value`.
+template<typename Enum>
+void select_equal(const Enum* column, std::size_t size, Enum value, std::uint64_t* bitmap) {
+    detail::EqualFilter<Enum>{value}(column, size, bitmap);
+}
+
+
+/**Mark the rows among the `size` items at `column` that are in `set`.
+ *
+ * Small sets are matched by comparing against each of their items;
+ * large sets by a lookup in the set's bitset.
+ */
+template<typename Enum>
+void select_in(
+    const Enum* column, std::size_t size,
+    const EnumSet<Enum>& set, std::uint64_t* bitmap
+) {
+    detail::SetFilter<Enum>{set}(column, size, bitmap);
+}
+
+
+/// Mark the rows of a packed `column` that equal `value`.
+template<typename Enum>
+void select_equal(const PackedColumn<Enum>& column, Enum value, std::uint64_t* bitmap) {
+    detail::run_packed_filter(column, 0, column.size(), bitmap, detail::EqualFilter<Enum>{value});
+}
+
+
+/// Mark the rows of a packed `column` that are in `set`.
+template<typename Enum>
+void select_in(const PackedColumn<Enum>& column, const EnumSet<Enum>& set, std::uint64_t* bitmap) {
+    detail::run_packed_filter(column, 0, column.size(), bitmap, detail::SetFilter<Enum>{set});
+}
+
+
+/// Return the number of rows selected in a bitmap of `size` rows.
+inline std::size_t count_selected(const std::uint64_t* bitmap, std::size_t size) {
+    std::size_t result = 0;
+    for (std::size_t i = 0; i < bitmap_words(size); ++i) {
+        result += detail::popcount(bitmap[i]);
+    }
+    return result;
+}
+
+
+/// Append the positions of all rows selected in a bitmap of `size` rows to `out`.
+template<typename Index = std::size_t>
+void selected_rows(const std::uint64_t* bitmap, std::size_t size, std::vector<Index>& out) {
+    for (std::size_t i = 0; i < bitmap_words(size); ++i) {
+        for (std::uint64_t word = bitmap[i]; word != 0; word &= word - 1) {
+            out.push_back(static_cast<Index>(i * 64 + detail::count_trailing_zeros(word)));
+        }
+    }
+}
+
+
+/**One selection bitmap per `enum` item over a fixed column.
+ *
+ * Building the index scans the column once. Afterwards, `column ==
+ * value` is a lookup and `column IN set` is a word-wise OR of the
+ * bitmaps of the set's items, which pays off for repeated queries.
+ */
+template<typename Enum>
+class BitmapIndex {
+public:
+    /// Index the `size` items at `column`.
+    BitmapIndex(const Enum* column, std::size_t size)
+        : m_rows(size), m_words(bitmap_words(size)),
+          m_bitmaps(Enumerate<Enum>::size() * m_words, 0)
+    {
+        for (std::size_t i = 0; i < size; ++i) {
+            const std::size_t index = to_index(column[i]);
+            if (index < Enumerate<Enum>::size()) {
+                m_bitmaps[index * m_words + i / 64] |= std::uint64_t{1} << (i % 64);
+            }
+        }
+    }
+
+    /// Return the number of indexed rows.
+    std::size_t rows() const { return m_rows; }
+
+    /// Return the selection bitmap of the rows that equal `value`.
+    const std::uint64_t* bitmap(Enum value) const {
+        return m_bitmaps.data() + to_index(value) * m_words;
+    }
+
+    /// Return the number of rows that equal `value`.
+    std::size_t count(Enum value) const {
+        return count_selected(bitmap(value), m_rows);
+    }
+
+    /// Mark the rows that are in `set`.
+    void select_in(const EnumSet<Enum>& set, std::uint64_t* out) const {
+        std::fill_n(out, m_words, 0);
+        for (const Enum item : set) {
+            const std::uint64_t* rows = bitmap(item);
+            for (std::size_t w = 0; w < m_words; ++w) {
+                out[w] |= rows[w];
+            }
+        }
+    }
+
+private:
+    /// Number of indexed rows.
+    std::size_t m_rows;
+
+    /// Number of words per bitmap.
+    std::size_t m_words;
+
+    /// The bitmaps of all items, one after the other.
+    std::vector<std::uint64_t> m_bitmaps;
+};
+
+}
+
+#endif // ENUMERATE_FILTER_HPP
@@ -0,0 +1,183 @@
+/*
+ * enumerate/flight_recorder.hpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Nico Madysa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENUMERATE_FLIGHT_RECORDER_HPP
+#define ENUMERATE_FLIGHT_RECORDER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+#include "../enumerate.hpp"
+
+
+namespace enumerate {
+
+/**Keeps the last `Depth` events of every item of an `enum`.
+ *
+ * Each item owns a ring of `Depth` slots in memory that is allocated
+ * once, when the recorder is created. Recording claims the next slot
+ * of the item's ring with one atomic increment and overwrites its
+ * oldest event, so frequent items never evict the events of rare ones.
+ *
+ * Slots are guarded by sequence locks: a reader that races with a
+ * writer detects the torn read and skips the event instead of
+ * reporting garbage. Readers never block writers. This makes it safe
+ * to dump a recorder while other threads keep recording, e.g. from a
+ * crash handler, as long as the callback itself is safe to call there.
+ *
+ * The guarantee assumes that one writer finishes a slot before the
+ * next writer of the same item laps the ring, i.e. that fewer than
+ * `Depth` threads record the same item at the same time.
+ *
+ * ```
+ * struct Event { std::uint64_t time; std::uint32_t id; };
+ * FlightRecorder<Request, Event, 16> recorder;
+ * recorder.record(Request::Login, Event{now(), id});
+ * recorder.dump([](Request kind, const Event& event) { ... });
+ * ```
+ */
+template<typename Enum, typename T, std::size_t Depth = 16>
+class FlightRecorder {
+    static_assert(std::is_trivially_copyable<T>::value
+                  && std::is_default_constructible<T>::value,
+                  "recorded events must be trivially copyable and default-constructible");
+    static_assert(Depth > 0 && (Depth & (Depth - 1)) == 0,
+                  "the depth must be a power of two");
+
+public:
+    /// Number of rings, i.e. the number of items in `Enum`.
+    static constexpr std::size_t count = Enumerate<Enum>::size();
+
+    /// Number of events retained per item.
+    static constexpr std::size_t depth = Depth;
+
+    /// Create a recorder without any events.
+    FlightRecorder() : m_rings(new Ring[count]) {}
+
+    FlightRecorder(const FlightRecorder&) = delete;
+    FlightRecorder& operator =(const FlightRecorder&) = delete;
+
+    /// Record `event` as the latest event of `item`.
+    void record(Enum item, const T& event) {
+        Ring& ring = m_rings[to_index(item)];
+        const std::uint64_t ticket = ring.head.fetch_add(1, std::memory_order_relaxed);
+        Slot& slot = ring.slots[ticket % Depth];
+        slot.sequence.store(2 * ticket + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::uint64_t words[word_count] = {};
+        std::memcpy(words, &event, sizeof(T));
+        for (std::size_t i = 0; i < word_count; ++i) {
+            slot.words[i].store(words[i], std::memory_order_relaxed);
+        }
+        slot.sequence.store(2 * ticket + 2, std::memory_order_release);
+    }
+
+    /// Return the number of events ever recorded for `item`.
+    std::uint64_t recorded(Enum item) const {
+        return m_rings[to_index(item)].head.load(std::memory_order_acquire);
+    }
+
+    /**Copy the retained events of `item` into `out`, oldest first.
+     *
+     * `out` must have room for `depth` events. Returns the number of
+     * events copied; events that are being overwritten are skipped.
+     */
+    std::size_t recent(Enum item, T* out) const {
+        std::size_t result = 0;
+        for_each(item, [&](const T& event) { out[result++] = event; });
+        return result;
+    }
+
+    /// Call `f(event)` for every retained event of `item`, oldest first.
+    template<typename F>
+    void for_each(Enum item, F f) const {
+        const Ring& ring = m_rings[to_index(item)];
+        const std::uint64_t head = ring.head.load(std::memory_order_acquire);
+        const std::uint64_t first = head > Depth ? head - Depth : 0;
+        for (std::uint64_t ticket = first; ticket < head; ++ticket) {
+            T event;
+            if (read(ring.slots[ticket % Depth], ticket, event)) {
+                f(static_cast<const T&>(event));
+            }
+        }
+    }
+
+    /// Call `f(item, event)` for the retained events of every item, in `enum` order.
+    template<typename F>
+    void dump(F f) const {
+        for (const Enum item : Enumerate<Enum>{}) {
+            for_each(item, [&](const T& event) { f(item, event); });
+        }
+    }
+
+private:
+    /// Number of atomic words needed to hold a `T`.
+    static constexpr std::size_t word_count = (sizeof(T) + 7) / 8;
+
+    /// A single event, guarded by a sequence number.
+    struct Slot {
+        /// `2 * ticket + 1` while being written, `2 * ticket + 2` afterwards.
+        std::atomic<std::uint64_t> sequence{0};
+        std::atomic<std::uint64_t> words[word_count] = {};
+    };
+
+    /// The ring of one item, starting on its own cache line.
+    struct alignas(64) Ring {
+        /// The ticket of the next event to be recorded.
+        std::atomic<std::uint64_t> head{0};
+        Slot slots[Depth];
+    };
+
+    /// Copy the event with `ticket` out of `slot`, unless it is being overwritten.
+    static bool read(const Slot& slot, std::uint64_t ticket, T& event) {
+        const std::uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before != 2 * ticket + 2) {
+            return false;
+        }
+        std::uint64_t words[word_count];
+        for (std::size_t i = 0; i < word_count; ++i) {
+            words[i] = slot.words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != before) {
+            return false;
+        }
+        std::memcpy(&event, words, sizeof(T));
+        return true;
+    }
+
+    std::unique_ptr<Ring[]> m_rings;
+};
+
+}
+
+#endif // ENUMERATE_FLIGHT_RECORDER_HPP
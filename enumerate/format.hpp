@@ -0,0 +1,185 @@
+/*
+ * enumerate/format.hpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Nico Madysa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENUMERATE_FORMAT_HPP
+#define ENUMERATE_FORMAT_HPP
+
+#include <charconv>
+#include <cstddef>
+#include <string_view>
+#include <type_traits>
+
+#include "../enumerate.hpp"
+#include "names.hpp"
+
+#if __has_include(<format>)
+#include <format>
+#endif
+
+#ifdef ENUMERATE_WITH_FMT
+#include <fmt/format.h>
+#endif
+
+
+namespace enumerate {
+
+namespace detail {
+
+/**The parsed format spec of an `enum` with registered names.
+ *
+ * The grammar is `[[fill]align][width][type]`, where `align` is one of
+ * `<`, `>` and `^`, and `type` is `s` for the name (the default) or
+ * `d` for the underlying integer. Items without a name, i.e. values
+ * outside of `BEGIN` and `END`, always print as integers. As with
+ * `std::format`, names are left-aligned and `d` right-aligned unless
+ * `align` says otherwise.
+ */
+struct EnumFormatSpec {
+    char fill = ' ';
+    /// One of `<`, `>` and `^`, or `'\0'` to use the default of `type`.
+    char align = '\0';
+    std::size_t width = 0;
+    bool numeric = false;
+
+    /// Parse the spec at `pos` and advance `pos` past it.
+    /// Return `false` if the spec is invalid.
+    template<typename It>
+    constexpr bool parse(It& pos, It end) {
+        auto is_align = [](char c) { return c == '<' || c == '>' || c == '^'; };
+        if (pos != end && pos + 1 != end && is_align(*(pos + 1))) {
+            fill = *pos;
+            align = *(pos + 1);
+            pos += 2;
+        } else if (pos != end && is_align(*pos)) {
+            align = *pos++;
+        }
+        while (pos != end && *pos >= '0' && *pos <= '9') {
+            width = width * 10 + static_cast<std::size_t>(*pos++ - '0');
+        }
+        if (pos != end && (*pos == 's' || *pos == 'd')) {
+            numeric = *pos++ == 'd';
+        }
+        return pos == end || *pos == '}';
+    }
+
+    /// Write `value` according to this spec to `out`.
+    template<typename Enum, typename OutIt>
+    OutIt format(Enum value, OutIt out) const {
+        using integral_type = typename Enumerate<Enum>::integral_type;
+        std::string_view text;
+        char digits[24];
+        if (!numeric && to_index(value) < NamePool<Enum>::count) {
+            text = NamePool<Enum>::name_at(to_index(value));
+        } else {
+            const auto result = std::to_chars(
+                digits, digits + sizeof(digits), static_cast<integral_type>(value));
+            text = std::string_view{digits, static_cast<std::size_t>(result.ptr - digits)};
+        }
+        const std::size_t padding = width > text.size() ? width - text.size() : 0;
+        const char side = align != '\0' ? align : numeric ? '>' : '<';
+        const std::size_t before =
+            side == '>' ? padding : side == '^' ? padding / 2 : 0;
+        for (std::size_t i = 0; i < before; ++i) {
+            *out++ = fill;
+        }
+        for (const char c : text) {
+            *out++ = c;
+        }
+        for (std::size_t i = before; i < padding; ++i) {
+            *out++ = fill;
+        }
+        return out;
+    }
+};
+
+}
+
+}
+
+
+#if defined(__cpp_lib_format) && defined(__cpp_concepts)
+/**Format an `enum` with registered names through `std::format`.
+ *
+ * The name is copied straight out of the `NamePool`; no intermediate
+ * `std::string` is created. See `detail::EnumFormatSpec` for the
+ * supported format specs.
+ *
+ * ```
+ * std::format("{:>8}|{:d}", Fruit::Pear, Fruit::Pear);  // "    Pear|2"
+ * ```
+ */
+template<typename Enum>
+    requires std::is_enum_v<Enum> && enumerate::has_names<Enum>::value
+struct std::formatter<Enum, char> {
+    constexpr auto parse(std::format_parse_context& ctx) {
+        auto pos = ctx.begin();
+        if (!m_spec.parse(pos, ctx.end())) {
+            throw std::format_error("invalid format spec for enum");
+        }
+        return pos;
+    }
+
+    template<typename FormatContext>
+    auto format(Enum value, FormatContext& ctx) const {
+        return m_spec.format(value, ctx.out());
+    }
+
+private:
+    enumerate::detail::EnumFormatSpec m_spec;
+};
+#endif
+
+
+#ifdef ENUMERATE_WITH_FMT
+/// Format an `enum` with registered names through `fmt::format`.
+/// This mirrors the `std::formatter` specialization.
+template<typename Enum>
+struct fmt::formatter<
+    Enum, char,
+    std::enable_if_t<std::is_enum<Enum>::value && enumerate::has_names<Enum>::value>
+> {
+    template<typename ParseContext>
+    constexpr auto parse(ParseContext& ctx) {
+        auto pos = ctx.begin();
+        if (!m_spec.parse(pos, ctx.end())) {
+            throw fmt::format_error("invalid format spec for enum");
+        }
+        return pos;
+    }
+
+    template<typename FormatContext>
+    auto format(Enum value, FormatContext& ctx) const {
+        return m_spec.format(value, ctx.out());
+    }
+
+private:
+    enumerate::detail::EnumFormatSpec m_spec;
+};
+#endif
+
+#endif // ENUMERATE_FORMAT_HPP
@@ -0,0 +1,251 @@
+/*
+ * enumerate/groups.hpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Nico Madysa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENUMERATE_GROUPS_HPP
+#define ENUMERATE_GROUPS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "../enumerate.hpp"
+
+
+namespace enumerate {
+
+/// A half-open range `[begin, end)` of `enum` items.
+template<typename Enum>
+struct GroupRange {
+    Enum begin;
+    Enum end;
+};
+
+
+/**Trait that divides an `enum` into named, contiguous groups.
+ *
+ * The primary template is left undefined. Groups are named by the
+ * items of a second `enum`, which itself follows the `enumerate`
+ * protocol. The groups' boundaries are usually marked inside the first
+ * `enum` the same way `BEGIN` and `END` mark the whole range:
+ *
+ * ```
+ * enum class Error {
+ *     BEGIN,
+ *     BEGIN_NETWORK = BEGIN,
+ *     Timeout = BEGIN_NETWORK,
+ *     Refused,
+ *     END_NETWORK,
+ *     BEGIN_DISK = END_NETWORK,
+ *     Full = BEGIN_DISK,
+ *     ReadOnly,
+ *     END_DISK,
+ *     END = END_DISK,
+ * };
+ *
+ * enum class ErrorFamily { BEGIN, Network = BEGIN, Disk, END };
+ *
+ * template<>
+ * struct enumerate::EnumGroups<Error> {
+ *     using group_type = ErrorFamily;
+ *     static constexpr GroupRange<Error> ranges[] = {
+ *         {Error::BEGIN_NETWORK, Error::END_NETWORK},
+ *         {Error::BEGIN_DISK, Error::END_DISK},
+ *     };
+ * };
+ * ```
+ *
+ * `ranges` lists one range per group, in the order of `group_type`.
+ * Ranges must lie within `BEGIN` and `END` and must not overlap; items
+ * that belong to no group are allowed.
+ */
+template<typename Enum>
+struct EnumGroups;
+
+
+namespace detail {
+
+/// Return `true` if the groups of `Enum` are well-formed.
+template<typename Enum>
+constexpr bool valid_groups() {
+    using groups = EnumGroups<Enum>;
+    constexpr std::size_t count = Enumerate<typename groups::group_type>::size();
+    if (std::extent<decltype(groups::ranges)>::value != count) {
+        return false;
+    }
+    for (std::size_t g = 0; g < count; ++g) {
+        const std::size_t begin = to_index(groups::ranges[g].begin);
+        const std::size_t end = to_index(groups::ranges[g].end);
+        if (begin > end || end > Enumerate<Enum>::size()) {
+            return false;
+        }
+        for (std::size_t h = 0; h < g; ++h) {
+            const std::size_t other_begin = to_index(groups::ranges[h].begin);
+            const std::size_t other_end = to_index(groups::ranges[h].end);
+            if (begin < other_end && other_begin < end) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/// The smallest unsigned type that can hold group positions and a sentinel.
+template<std::size_t Groups>
+using group_index_t = std::conditional_t<(Groups < 0xff), std::uint8_t, std::uint16_t>;
+
+/**Build the table that maps every item position to its group position.
+ *
+ * The table has one extra slot past the last item, which maps `END`
+ * and every value outside `[BEGIN, END)` to the `END` group.
+ */
+template<typename Enum>
+constexpr auto build_group_table() {
+    using groups = EnumGroups<Enum>;
+    constexpr std::size_t count = Enumerate<typename groups::group_type>::size();
+    using index_type = group_index_t<count>;
+    std::array<index_type, Enumerate<Enum>::size() + 1> table{};
+    for (auto& entry : table) {
+        entry = static_cast<index_type>(count);
+    }
+    for (std::size_t g = 0; g < count; ++g) {
+        for (std::size_t i = to_index(groups::ranges[g].begin);
+             i < to_index(groups::ranges[g].end); ++i) {
+            table[i] = static_cast<index_type>(g);
+        }
+    }
+    return table;
+}
+
+/// The group of every item, computed at compile time.
+template<typename Enum>
+struct GroupTable {
+    static_assert(valid_groups<Enum>(),
+                  "EnumGroups must list one non-overlapping range per group");
+    static constexpr auto table = build_group_table<Enum>();
+};
+
+}
+
+
+/// The `enum` that names the groups of `Enum`.
+template<typename Enum>
+using group_t = typename EnumGroups<Enum>::group_type;
+
+
+/**Return the group that `item` belongs to.
+ *
+ * This is a single load from a table computed at compile time. Items
+ * that belong to no group, `END` and values outside `[BEGIN, END)`
+ * yield `group_t<Enum>::END`.
+ */
+template<typename Enum>
+constexpr group_t<Enum> group_of(Enum item) {
+    constexpr std::size_t size = Enumerate<Enum>::size();
+    const std::size_t index = to_index(item);
+    return from_index<group_t<Enum>>(detail::GroupTable<Enum>::table[index < size ? index : size]);
+}
+
+
+/// Return `true` if `item` belongs to `group`.
+template<typename Enum>
+constexpr bool in_group(Enum item, group_t<Enum> group) {
+    const auto range = EnumGroups<Enum>::ranges[to_index(group)];
+    return range.begin <= item && item < range.end;
+}
+
+
+/**Iterate over all items in one group of an `enum`.
+ *
+ * This is the counterpart of `Enumerate` for a single group:
+ *
+ * ```
+ * for (const auto error : EnumerateGroup<Error, ErrorFamily::Network>{}) {
+ *     std::cout << name(error) << std::endl;
+ * }
+ * ```
+ */
+template<typename Enum, group_t<Enum> Group>
+struct EnumerateGroup {
+    /// `EnumerateGroup`s are compile-time constants.
+    constexpr EnumerateGroup() = default;
+
+    /// `Enum`.
+    using value_type = Enum;
+
+    /// The corresponding forwards iterator.
+    using iterator = EnumIter<value_type>;
+
+    /// The corresponding backwards iterator.
+    using reverse_iterator = ReverseEnumIter<value_type>;
+
+    static_assert(detail::valid_groups<Enum>(),
+                  "EnumGroups must list one non-overlapping range per group");
+
+    /// The first item of the group.
+    static constexpr value_type begin_value = EnumGroups<Enum>::ranges[to_index(Group)].begin;
+
+    /// The item past the last item of the group.
+    static constexpr value_type end_value = EnumGroups<Enum>::ranges[to_index(Group)].end;
+
+    /// Return the number of items in the group.
+    static constexpr std::size_t size() {
+        return to_index(end_value) - to_index(begin_value);
+    }
+
+    /// Return an iterator to the group's first item.
+    constexpr iterator begin() const {
+        return iterator{begin_value};
+    }
+
+    /// Return an iterator past the group's last item.
+    constexpr iterator end() const {
+        return iterator{end_value};
+    }
+
+    /// Return a reverse iterator to the group's last item.
+    constexpr reverse_iterator rbegin() const {
+        return ++reverse_iterator{end_value};
+    }
+
+    /// Return a reverse iterator before the group's first item.
+    constexpr reverse_iterator rend() const {
+        return ++reverse_iterator{begin_value};
+    }
+};
+
+
+#ifdef __cpp_variable_templates
+/// Variable template that is equivalent to `EnumerateGroup`.
+template<typename Enum, group_t<Enum> Group>
+static constexpr auto enumerate_group = EnumerateGroup<Enum, Group>{};
+#endif
+
+}
+
+#endif // ENUMERATE_GROUPS_HPP
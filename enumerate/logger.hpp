@@ -0,0 +1,390 @@
+/*
+ * enumerate/logger.hpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Nico Madysa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENUMERATE_LOGGER_HPP
+#define ENUMERATE_LOGGER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../enumerate.hpp"
+#include "containers.hpp"
+
+
+namespace enumerate {
+
+/// A single log message, as it is handed to a `Logger`'s sink.
+template<typename Level, typename Subsystem, std::size_t MessageSize = 200>
+struct LogRecord {
+    /// When the message was logged.
+    std::chrono::system_clock::time_point time;
+
+    /// The severity of the message.
+    Level level;
+
+    /// The part of the program that logged the message.
+    Subsystem subsystem;
+
+    /// The length of the message, excluding the terminating null byte.
+    std::uint32_t length;
+
+    /// The message, truncated to `MessageSize - 1` characters.
+    char text[MessageSize];
+
+    /// Return the message.
+    std::string_view message() const { return std::string_view{text, length}; }
+};
+
+
+namespace detail {
+
+/**A bounded queue with a single producer and a single consumer.
+ *
+ * `Capacity` must be a power of two. The producer and the consumer
+ * indices live on separate cache lines, and each side caches the other
+ * side's index to avoid touching its cache line on every operation.
+ */
+template<typename T, std::size_t Capacity>
+class SpscRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                  "ring capacity must be a power of two");
+
+public:
+    /// Return the slot to fill next, or `nullptr` if the ring is full.
+    T* prepare() {
+        const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cached_head == Capacity) {
+            m_cached_head = m_head.load(std::memory_order_acquire);
+            if (tail - m_cached_head == Capacity) {
+                return nullptr;
+            }
+        }
+        return &m_slots[tail % Capacity];
+    }
+
+    /// Publish the slot returned by `prepare()`.
+    void commit() {
+        m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /// Return the oldest slot, or `nullptr` if the ring is empty.
+    const T* front() {
+        const std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cached_tail) {
+            m_cached_tail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cached_tail) {
+                return nullptr;
+            }
+        }
+        return &m_slots[head % Capacity];
+    }
+
+    /// Release the slot returned by `front()`.
+    void pop() {
+        m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    /// Written by the consumer.
+    alignas(64) std::atomic<std::size_t> m_head{0};
+    std::size_t m_cached_tail = 0;
+
+    /// Written by the producer.
+    alignas(64) std::atomic<std::size_t> m_tail{0};
+    std::size_t m_cached_head = 0;
+
+    alignas(64) T m_slots[Capacity];
+};
+
+/// Return a number that is unique to each logger ever created.
+inline std::uint64_t next_logger_id() {
+    static std::atomic<std::uint64_t> next_id{1};
+    return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+}
+
+
+/**An asynchronous logger whose levels and subsystems are `enum`s.
+ *
+ * Both `Level` and `Subsystem` follow the `enumerate` protocol; levels
+ * are ordered by severity, the least severe first. Messages below
+ * `MinLevel` are removed at compile time, because the level is a
+ * template argument of `log()`. Subsystems can be switched on and off
+ * at run time; checking them costs one relaxed atomic load. Only
+ * messages that pass both filters are formatted.
+ *
+ * Every thread that logs gets its own ring buffer of `RingSize`
+ * records, so logging never takes a lock after a thread's first
+ * message. A background thread drains all rings and hands each record
+ * to the sink. When a thread exits, its ring is freed as soon as it has
+ * been drained. Records from one thread reach the sink in order; records
+ * from different threads may interleave. If a thread's ring is full,
+ * its messages are dropped and counted rather than blocking the thread.
+ *
+ * ```
+ * enum class Level { BEGIN, Debug = BEGIN, Info, Warning, Error, END };
+ * enum class Subsystem { BEGIN, Net = BEGIN, Disk, END };
+ * using Log = Logger<Level, Subsystem, Level::Info>;
+ *
+ * Log logger{[](const Log::record_type& r) { std::cerr << r.message() << '\n'; }};
+ * logger.log<Level::Warning>(Subsystem::Net, "connection %d refused", fd);
+ * logger.log<Level::Debug>(Subsystem::Net, "never formatted, never compiled");
+ * ```
+ */
+template<typename Level, typename Subsystem, Level MinLevel = Level::BEGIN,
+         std::size_t RingSize = 1024>
+class Logger {
+public:
+    /// The records handed to the sink.
+    using record_type = LogRecord<Level, Subsystem>;
+
+    /// The function that receives every record.
+    using sink_type = std::function<void(const record_type&)>;
+
+    /**Start the background thread that passes records to `sink`.
+     *
+     * The thread sleeps for `poll_interval` whenever it finds all rings
+     * empty. All subsystems are enabled initially.
+     */
+    explicit Logger(sink_type sink,
+                    std::chrono::microseconds poll_interval = std::chrono::milliseconds{1})
+        : m_sink(std::move(sink)), m_enabled(EnumSet<Subsystem>::all()),
+          m_poll_interval(poll_interval)
+    {
+        m_drain_thread = std::thread{[this] { run(); }};
+    }
+
+    Logger(const Logger&) = delete;
+    Logger& operator =(const Logger&) = delete;
+
+    /// Stop the background thread after passing all pending records on.
+    ~Logger() {
+        m_stop.store(true, std::memory_order_release);
+        m_drain_thread.join();
+        drain();
+        for (const auto& ring : m_rings) {
+            ring->closed.store(true, std::memory_order_release);
+        }
+    }
+
+    /// Return `true` if messages of `level` are compiled in.
+    static constexpr bool compiled_in(Level level) { return level >= MinLevel; }
+
+    /// Enable messages from `subsystem`.
+    void enable(Subsystem subsystem) { m_enabled.insert(subsystem); }
+
+    /// Discard messages from `subsystem` without formatting them.
+    void disable(Subsystem subsystem) { m_enabled.erase(subsystem); }
+
+    /// Return `true` if messages of level `L` from `subsystem` are logged.
+    template<Level L>
+    bool enabled(Subsystem subsystem) const {
+        if constexpr (!compiled_in(L)) {
+            return false;
+        } else {
+            return m_enabled.contains(subsystem);
+        }
+    }
+
+    /**Log a message of level `L` from `subsystem`.
+     *
+     * `format` and `args` are passed to `std::snprintf()` if, and only
+     * if, the message passes both filters. Without `args`, `format` is
+     * copied verbatim.
+     */
+    template<Level L, typename... Args>
+    void log(Subsystem subsystem, const char* format, const Args&... args) {
+        if constexpr (compiled_in(L)) {
+            if (!m_enabled.contains(subsystem)) {
+                return;
+            }
+            ring_type& ring = this_thread_ring();
+            record_type* const record = ring.prepare();
+            if (record == nullptr) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            record->time = std::chrono::system_clock::now();
+            record->level = L;
+            record->subsystem = subsystem;
+            int length;
+            if constexpr (sizeof...(Args) == 0) {
+                length = std::snprintf(record->text, sizeof(record->text), "%s", format);
+            } else {
+                length = std::snprintf(record->text, sizeof(record->text), format, args...);
+            }
+            record->length = static_cast<std::uint32_t>(length < 0 ? 0
+                : std::min<std::size_t>(length, sizeof(record->text) - 1));
+            ring.commit();
+        }
+    }
+
+    /// Return the number of messages dropped because a ring was full.
+    std::uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    /**Pass all pending records to the sink now.
+     *
+     * Returns the number of records passed on. This may be called from
+     * any thread, e.g. before the program exits after a fatal error.
+     */
+    std::size_t drain() {
+        std::lock_guard<std::mutex> lock{m_drain_mutex};
+        // Only `drain()` removes rings, so they outlive this copy.
+        std::vector<thread_ring*> rings;
+        {
+            std::lock_guard<std::mutex> rings_lock{m_rings_mutex};
+            for (const auto& ring : m_rings) {
+                rings.push_back(ring.get());
+            }
+        }
+        std::size_t result = 0;
+        bool any_retired = false;
+        for (thread_ring* ring : rings) {
+            // Read the flag first: a retired ring gets no further
+            // records, so it is empty once drained.
+            const bool retired = ring->retired.load(std::memory_order_acquire);
+            while (const record_type* record = ring->ring.front()) {
+                m_sink(*record);
+                ring->ring.pop();
+                ++result;
+            }
+            ring->drained = retired;
+            any_retired = any_retired || retired;
+        }
+        if (any_retired) {
+            std::lock_guard<std::mutex> rings_lock{m_rings_mutex};
+            m_rings.erase(std::remove_if(m_rings.begin(), m_rings.end(),
+                                         [](const auto& ring) { return ring->drained; }),
+                          m_rings.end());
+        }
+        return result;
+    }
+
+private:
+    using ring_type = detail::SpscRing<record_type, RingSize>;
+
+    /// The ring of one thread, shared by the logger and that thread.
+    struct thread_ring {
+        ring_type ring;
+
+        /// Set when the thread has exited; it will not log again.
+        std::atomic<bool> retired{false};
+
+        /// Set when the logger has been destroyed.
+        std::atomic<bool> closed{false};
+
+        /// Set by `drain()` on a retired ring that it has emptied.
+        bool drained = false;
+    };
+
+    /// A thread's rings, one per logger that it has used.
+    struct ring_cache {
+        std::vector<std::pair<std::uint64_t, std::shared_ptr<thread_ring>>> entries;
+
+        /// Hand the thread's rings over to their loggers, which free
+        /// them once they are drained.
+        ~ring_cache() {
+            for (const auto& entry : entries) {
+                entry.second->retired.store(true, std::memory_order_release);
+            }
+        }
+    };
+
+    /// Return the calling thread's ring, creating it on first use.
+    ring_type& this_thread_ring() {
+        // Logger ids are never reused, so a cached ring of a destroyed
+        // logger is never mistaken for one of this logger.
+        thread_local ring_cache cache;
+        for (const auto& entry : cache.entries) {
+            if (entry.first == m_id) {
+                return entry.second->ring;
+            }
+        }
+        // Forget the rings of destroyed loggers before adding one.
+        auto& entries = cache.entries;
+        entries.erase(std::remove_if(entries.begin(), entries.end(), [](const auto& entry) {
+            return entry.second->closed.load(std::memory_order_acquire);
+        }), entries.end());
+        auto ring = std::make_shared<thread_ring>();
+        {
+            std::lock_guard<std::mutex> lock{m_rings_mutex};
+            m_rings.push_back(ring);
+        }
+        entries.emplace_back(m_id, ring);
+        return ring->ring;
+    }
+
+    /// The body of the background thread.
+    void run() {
+        while (!m_stop.load(std::memory_order_acquire)) {
+            if (drain() == 0) {
+                std::this_thread::sleep_for(m_poll_interval);
+            }
+        }
+    }
+
+    /// Unique among all loggers of the process.
+    const std::uint64_t m_id = detail::next_logger_id();
+
+    sink_type m_sink;
+
+    /// The subsystems whose messages are logged.
+    AtomicEnumSet<Subsystem> m_enabled;
+
+    /// Messages dropped because a ring was full.
+    std::atomic<std::uint64_t> m_dropped{0};
+
+    /// One ring per live thread that has logged, plus the rings of
+    /// exited threads that still hold records.
+    std::vector<std::shared_ptr<thread_ring>> m_rings;
+    std::mutex m_rings_mutex;
+
+    /// Ensures that each ring has a single consumer.
+    std::mutex m_drain_mutex;
+
+    std::chrono::microseconds m_poll_interval;
+    std::atomic<bool> m_stop{false};
+    std::thread m_drain_thread;
+};
+
+}
+
+#endif // ENUMERATE_LOGGER_HPP
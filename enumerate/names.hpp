@@ -0,0 +1,301 @@
+/*
+ * enumerate/names.hpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Nico Madysa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENUMERATE_NAMES_HPP
+#define ENUMERATE_NAMES_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+
+#include "../enumerate.hpp"
+
+
+namespace enumerate {
+
+/**Trait that registers the names of an `enum`'s items.
+ *
+ * The primary template is left undefined. To give an `enum` names,
+ * specialize it with an array `names` that lists one name per item,
+ * in order from `BEGIN` to `END`:
+ *
+ * ```
+ * template<>
+ * struct enumerate::EnumNames<Fruit> {
+ *     static constexpr const char* names[] = {"Apple", "Orange", "Pear"};
+ * };
+ * ```
+ */
+template<typename Enum>
+struct EnumNames;
+
+
+/// `true_type` if `EnumNames` has been specialized for `Enum`.
+template<typename Enum, typename = void>
+struct has_names : std::false_type {};
+
+template<typename Enum>
+struct has_names<Enum, std::void_t<decltype(EnumNames<Enum>::names)>>
+    : std::true_type {};
+
+
+namespace detail {
+
+/// 64-bit FNV-1a offset basis.
+constexpr std::uint64_t fnv_offset = 0xcbf29ce484222325ull;
+
+/// Feed `size` bytes of `data` into the FNV-1a hash `hash`.
+constexpr std::uint64_t fnv1a(
+    std::uint64_t hash, const char* data, std::size_t size
+) {
+    for (std::size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+/// Feed the eight bytes of `value` into `hash`, least significant first.
+constexpr std::uint64_t fnv1a_u64(std::uint64_t hash, std::uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        hash ^= (value >> (8 * i)) & 0xff;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+/// Hash a name the same way at compile time and at run time.
+constexpr std::uint64_t hash_name(std::string_view name) {
+    return fnv1a(fnv_offset, name.data(), name.size());
+}
+
+/// Return the smallest power of two that is at least `n`.
+constexpr std::size_t ceil_pow2(std::size_t n) {
+    std::size_t result = 1;
+    while (result < n) {
+        result *= 2;
+    }
+    return result;
+}
+
+/// Return the summed length of all names registered for `Enum`.
+template<typename Enum>
+constexpr std::size_t total_name_length() {
+    std::size_t total = 0;
+    for (const char* name : EnumNames<Enum>::names) {
+        total += std::string_view{name}.size();
+    }
+    return total;
+}
+
+/// Concatenate all names registered for `Enum`.
+template<typename Enum, std::size_t Size>
+constexpr std::array<char, Size> build_name_chars() {
+    std::array<char, Size> chars{};
+    std::size_t pos = 0;
+    for (const char* name : EnumNames<Enum>::names) {
+        for (const char c : std::string_view{name}) {
+            chars[pos++] = c;
+        }
+    }
+    return chars;
+}
+
+/// Compute where each name starts in the concatenation of all names.
+template<typename Enum>
+constexpr auto build_name_offsets() {
+    constexpr std::size_t count = Enumerate<Enum>::size();
+    std::array<std::uint32_t, count + 1> offsets{};
+    std::size_t pos = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        offsets[i] = static_cast<std::uint32_t>(pos);
+        pos += std::string_view{EnumNames<Enum>::names[i]}.size();
+    }
+    offsets[count] = static_cast<std::uint32_t>(pos);
+    return offsets;
+}
+
+/**Build an open-addressing table from name hashes to positions.
+ *
+ * Slots hold `index + 1`; zero marks an empty slot. `Size` must be a
+ * power of two greater than the number of names.
+ */
+template<typename Enum, std::size_t Size>
+constexpr std::array<std::uint32_t, Size> build_name_table() {
+    std::array<std::uint32_t, Size> table{};
+    for (std::size_t i = 0; i < Enumerate<Enum>::size(); ++i) {
+        std::size_t slot = hash_name(EnumNames<Enum>::names[i]) & (Size - 1);
+        while (table[slot] != 0) {
+            slot = (slot + 1) & (Size - 1);
+        }
+        table[slot] = static_cast<std::uint32_t>(i + 1);
+    }
+    return table;
+}
+
+}
+
+
+/**All names of an `enum`, packed into one contiguous character array.
+ *
+ * The pool is built at compile time from `EnumNames<Enum>`. Looking up
+ * a name is a pair of loads from a table of offsets; parsing a name is
+ * a single hash plus, usually, a single comparison against an
+ * open-addressing table that has also been built at compile time.
+ */
+template<typename Enum>
+class NamePool {
+    static_assert(has_names<Enum>::value,
+                  "EnumNames must be specialized for this enum");
+
+    /// The registered names.
+    using names_type = EnumNames<Enum>;
+
+public:
+    /// `Enum`.
+    using value_type = Enum;
+
+    /// Number of items between `BEGIN` and `END`.
+    static constexpr std::size_t count = Enumerate<Enum>::size();
+
+    static_assert(std::extent<decltype(names_type::names)>::value == count,
+                  "EnumNames must list exactly one name per enum item");
+
+    /// Number of characters in the pool, without any terminators.
+    static constexpr std::size_t pool_size = detail::total_name_length<Enum>();
+
+    /// Number of slots in the hash table used by `parse()`.
+    static constexpr std::size_t table_size = detail::ceil_pow2(2 * count + 1);
+
+private:
+    static constexpr std::array<char, pool_size + 1> m_chars =
+        detail::build_name_chars<Enum, pool_size + 1>();
+    static constexpr std::array<std::uint32_t, count + 1> m_offsets =
+        detail::build_name_offsets<Enum>();
+    static constexpr std::array<std::uint32_t, table_size> m_table =
+        detail::build_name_table<Enum, table_size>();
+
+public:
+    /// Return a pointer to the first character of the pool.
+    static constexpr const char* data() { return m_chars.data(); }
+
+    /// Return the offsets of all names; the last entry is `pool_size`.
+    static constexpr const std::uint32_t* offsets() { return m_offsets.data(); }
+
+    /// Return the name at zero-based position `index`, unchecked.
+    static constexpr std::string_view name_at(std::size_t index) {
+        return std::string_view{
+            m_chars.data() + m_offsets[index],
+            m_offsets[index + 1] - m_offsets[index]};
+    }
+
+    /// Return the name of `value`, or an empty view if it is out of range.
+    static constexpr std::string_view name(Enum value) {
+        const std::size_t index = to_index(value);
+        return index < count ? name_at(index) : std::string_view{};
+    }
+
+    /// Return the zero-based position of `name`, or `count` if unknown.
+    static constexpr std::size_t find(std::string_view name) {
+        std::size_t slot = detail::hash_name(name) & (table_size - 1);
+        while (m_table[slot] != 0) {
+            const std::size_t index = m_table[slot] - 1;
+            if (name_at(index) == name) {
+                return index;
+            }
+            slot = (slot + 1) & (table_size - 1);
+        }
+        return count;
+    }
+
+    /// Return the item called `name`, if there is one.
+    static constexpr std::optional<Enum> parse(std::string_view name) {
+        const std::size_t index = find(name);
+        if (index == count) {
+            return std::nullopt;
+        }
+        return from_index<Enum>(index);
+    }
+};
+
+
+/**Return the registered name of `value`.
+ *
+ * \throws std::out_of_range if `value` is not between `BEGIN` and `END`.
+ */
+template<typename Enum>
+constexpr std::string_view to_name(Enum value) {
+    if (to_index(value) >= NamePool<Enum>::count) {
+        throw std::out_of_range("enumerate::to_name");
+    }
+    return NamePool<Enum>::name_at(to_index(value));
+}
+
+
+/// Return the item whose registered name is `name`, if there is one.
+template<typename Enum>
+constexpr std::optional<Enum> parse(std::string_view name) {
+    return NamePool<Enum>::parse(name);
+}
+
+
+/**Compute a fingerprint of an `enum`'s layout.
+ *
+ * The fingerprint covers the width and signedness of the underlying
+ * type, the values of `BEGIN` and `END` and, if the `enum` has
+ * registered names, every name in order. Two builds that agree on the
+ * fingerprint agree on what every underlying integer means, so data
+ * written by one can be read by the other without translation.
+ */
+template<typename Enum>
+constexpr std::uint64_t fingerprint() {
+    using integral_type = typename Enumerate<Enum>::integral_type;
+    std::uint64_t hash = detail::fnv_offset;
+    hash = detail::fnv1a_u64(hash, sizeof(integral_type));
+    hash = detail::fnv1a_u64(hash, std::is_signed<integral_type>::value);
+    hash = detail::fnv1a_u64(hash, static_cast<std::uint64_t>(
+        static_cast<integral_type>(Enumerate<Enum>::begin_value)));
+    hash = detail::fnv1a_u64(hash, Enumerate<Enum>::size());
+    if constexpr (has_names<Enum>::value) {
+        for (std::size_t i = 0; i < NamePool<Enum>::count; ++i) {
+            const auto name = NamePool<Enum>::name_at(i);
+            hash = detail::fnv1a(hash, name.data(), name.size());
+            // Separate the names so that "ab", "c" differs from "a", "bc".
+            hash = detail::fnv1a(hash, "", 1);
+        }
+    }
+    return hash;
+}
+
+}
+
+#endif // ENUMERATE_NAMES_HPP
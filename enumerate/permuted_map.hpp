@@ -0,0 +1,235 @@
+/*
+ * enumerate/permuted_map.hpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Nico Madysa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENUMERATE_PERMUTED_MAP_HPP
+#define ENUMERATE_PERMUTED_MAP_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+#include "../enumerate.hpp"
+#include "containers.hpp"
+
+
+namespace enumerate {
+
+namespace detail {
+
+/// The smallest unsigned type that can hold every slot position of `Enum`.
+template<std::size_t Size>
+using slot_index_t = std::conditional_t<
+    (Size <= 0xff), std::uint8_t,
+    std::conditional_t<(Size <= 0xffff), std::uint16_t, std::uint32_t>>;
+
+/// Return `true` if `Profile::hot` lists distinct items of `Enum`.
+template<typename Enum, typename Profile>
+constexpr bool valid_hot_order() {
+    constexpr std::size_t hot = std::extent<decltype(Profile::hot)>::value;
+    std::array<bool, Enumerate<Enum>::size()> seen{};
+    for (std::size_t i = 0; i < hot; ++i) {
+        const Enum key = Profile::hot[i];
+        if (key < Enum::BEGIN || key >= Enum::END || seen[to_index(key)]) {
+            return false;
+        }
+        seen[to_index(key)] = true;
+    }
+    return true;
+}
+
+/**Build the permutation from item positions to slots.
+ *
+ * The items listed in `Profile::hot` come first, in the listed order;
+ * all other items follow in `enum` order.
+ */
+template<typename Enum, typename Profile>
+constexpr auto build_slot_table() {
+    constexpr std::size_t size = Enumerate<Enum>::size();
+    constexpr std::size_t hot = std::extent<decltype(Profile::hot)>::value;
+    using index_type = slot_index_t<size>;
+    std::array<index_type, size> slots{};
+    std::array<bool, size> placed{};
+    for (std::size_t i = 0; i < hot; ++i) {
+        slots[to_index(Profile::hot[i])] = static_cast<index_type>(i);
+        placed[to_index(Profile::hot[i])] = true;
+    }
+    std::size_t next = hot;
+    for (std::size_t i = 0; i < size; ++i) {
+        if (!placed[i]) {
+            slots[i] = static_cast<index_type>(next++);
+        }
+    }
+    return slots;
+}
+
+/// Invert the permutation built by `build_slot_table()`.
+template<typename Enum, typename Profile>
+constexpr auto build_key_table() {
+    constexpr std::size_t size = Enumerate<Enum>::size();
+    constexpr auto slots = build_slot_table<Enum, Profile>();
+    std::array<slot_index_t<size>, size> keys{};
+    for (std::size_t i = 0; i < size; ++i) {
+        keys[slots[i]] = static_cast<slot_index_t<size>>(i);
+    }
+    return keys;
+}
+
+}
+
+
+/**An `EnumMap` whose slots are stored in a profile-guided order.
+ *
+ * `EnumMap` stores its slots in `enum` order. If a few keys take most
+ * lookups and the values are large, these keys end up spread across
+ * many cache lines. `PermutedEnumMap` instead stores the keys listed
+ * in `Profile::hot` first, so that they share as few cache lines as
+ * possible; all other keys follow in `enum` order.
+ *
+ * ```
+ * struct OpcodeProfile {
+ *     static constexpr Opcode hot[] = {Opcode::Load, Opcode::Add, Opcode::Jump};
+ * };
+ * PermutedEnumMap<Opcode, Handler, OpcodeProfile> handlers;
+ * ```
+ *
+ * The permutation is a table computed at compile time, so lookup is
+ * one extra load from a small, shared table. A hot order can be
+ * recorded with `EnumProfiler` and generated by `write_hot_order()`.
+ */
+template<typename Enum, typename T, typename Profile>
+class PermutedEnumMap {
+    static_assert(detail::valid_hot_order<Enum, Profile>(),
+                  "Profile::hot must list distinct items between BEGIN and END");
+
+public:
+    /// `Enum`.
+    using key_type = Enum;
+
+    /// `T`.
+    using mapped_type = T;
+
+    /// Number of slots, i.e. the number of items in `Enum`.
+    static constexpr std::size_t static_size = Enumerate<Enum>::size();
+
+    /// The underlying storage.
+    using storage_type = std::array<T, static_size>;
+
+    /// Iterators over the slots in storage order, i.e. hot keys first.
+    using iterator = typename storage_type::iterator;
+    using const_iterator = typename storage_type::const_iterator;
+
+    /// Value-initialize every slot.
+    constexpr PermutedEnumMap() = default;
+
+    /// Initialize every slot with a copy of `value`.
+    explicit PermutedEnumMap(const T& value) {
+        m_data.fill(value);
+    }
+
+    /// Copy the values of an `EnumMap` into permuted order.
+    explicit PermutedEnumMap(const EnumMap<Enum, T>& map) {
+        for (const auto key : Enumerate<Enum>{}) {
+            (*this)[key] = map[key];
+        }
+    }
+
+    /// Return the storage position of `key`.
+    static constexpr std::size_t slot(Enum key) { return slots[to_index(key)]; }
+
+    /// Return the key whose value is stored at position `slot`.
+    static constexpr Enum key_at(std::size_t slot) { return from_index<Enum>(keys_by_slot[slot]); }
+
+    /// Return the slot of `key`, unchecked.
+    constexpr T& operator [](Enum key) { return m_data[slot(key)]; }
+
+    /// Return the slot of `key`, unchecked.
+    constexpr const T& operator [](Enum key) const { return m_data[slot(key)]; }
+
+    /// Return the slot of `key`.
+    /// \throws std::out_of_range if `key` is not between `BEGIN` and `END`.
+    T& at(Enum key) { return m_data[checked_slot(key)]; }
+
+    /// Return the slot of `key`.
+    /// \throws std::out_of_range if `key` is not between `BEGIN` and `END`.
+    const T& at(Enum key) const { return m_data[checked_slot(key)]; }
+
+    /// Return the range of keys, in `enum` order.
+    static constexpr Enumerate<Enum> keys() { return Enumerate<Enum>{}; }
+
+    /// Return the number of slots.
+    static constexpr std::size_t size() { return static_size; }
+
+    /// Assign `value` to every slot.
+    void fill(const T& value) { m_data.fill(value); }
+
+    /// Copy the values back into an `EnumMap`.
+    EnumMap<Enum, T> to_map() const {
+        EnumMap<Enum, T> result;
+        for (const auto key : Enumerate<Enum>{}) {
+            result[key] = (*this)[key];
+        }
+        return result;
+    }
+
+    /// Return a pointer to the first slot in storage order.
+    constexpr T* data() { return m_data.data(); }
+    constexpr const T* data() const { return m_data.data(); }
+
+    /// Iterate over the values in storage order; see `key_at()`.
+    constexpr iterator begin() { return m_data.begin(); }
+    constexpr iterator end() { return m_data.end(); }
+    const_iterator begin() const { return m_data.begin(); }
+    const_iterator end() const { return m_data.end(); }
+
+    /// Maps are equal if all of their slots are equal.
+    bool operator ==(const PermutedEnumMap& rhs) const { return m_data == rhs.m_data; }
+    bool operator !=(const PermutedEnumMap& rhs) const { return m_data != rhs.m_data; }
+
+private:
+    static std::size_t checked_slot(Enum key) {
+        if (key < Enum::BEGIN || key >= Enum::END) {
+            throw std::out_of_range("enumerate::PermutedEnumMap::at");
+        }
+        return slot(key);
+    }
+
+    /// Storage position of each item position.
+    static constexpr auto slots = detail::build_slot_table<Enum, Profile>();
+
+    /// Item position of each storage position.
+    static constexpr auto keys_by_slot = detail::build_key_table<Enum, Profile>();
+
+    /// One slot per item, hot keys first.
+    storage_type m_data{};
+};
+
+}
+
+#endif // ENUMERATE_PERMUTED_MAP_HPP
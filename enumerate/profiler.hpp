@@ -0,0 +1,459 @@
+/*
+ * enumerate/profiler.hpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Nico Madysa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENUMERATE_PROFILER_HPP
+#define ENUMERATE_PROFILER_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cinttypes>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "../enumerate.hpp"
+#include "containers.hpp"
+#include "names.hpp"
+#include "serialize.hpp"
+
+
+/**Count how often an `enum` value is produced or dispatched.
+ *
+ * `ENUMERATE_PROFILE(value)` evaluates to `value`. If the macro
+ * `ENUMERATE_ENABLE_PROFILING` is defined, it also increments the
+ * counter of `value` in `EnumProfiler`; otherwise, it costs nothing:
+ *
+ * ```
+ * switch (ENUMERATE_PROFILE(instruction.opcode)) {
+ *     ...
+ * }
+ * ```
+ */
+#ifdef ENUMERATE_ENABLE_PROFILING
+#define ENUMERATE_PROFILE(value) (::enumerate::detail::profile_value(value))
+#else
+#define ENUMERATE_PROFILE(value) (value)
+#endif
+
+
+namespace enumerate {
+
+namespace detail {
+
+/// Return the shard that the calling thread should use.
+inline std::size_t this_thread_shard() {
+    static std::atomic<std::size_t> next_shard{0};
+    thread_local const std::size_t shard =
+        next_shard.fetch_add(1, std::memory_order_relaxed);
+    return shard;
+}
+
+}
+
+
+/**Per-item event counters that scale with the number of threads.
+ *
+ * A single shared counter per item turns every increment into a cache
+ * line transfer between cores. Instead, each thread increments the
+ * counters of one of `Shards` copies, picked round-robin when the
+ * thread first counts something. Each copy starts on its own cache
+ * line. Reading the counts sums all copies, so it is meant for reports,
+ * not for hot paths.
+ *
+ * Values outside `[BEGIN, END)`, e.g. corrupted ones, are not items;
+ * they are counted in a spare slot per shard, see `out_of_range()`.
+ */
+template<typename Enum, std::size_t Shards = 16>
+class ShardedEnumCounters {
+    static_assert(Shards > 0, "there must be at least one shard");
+
+public:
+    /// The type of a single counter.
+    using counter_type = std::atomic<std::uint64_t>;
+
+    /// Number of counters per shard, i.e. the number of items in `Enum`.
+    static constexpr std::size_t count = Enumerate<Enum>::size();
+
+    /// Create counters that are all zero.
+    ShardedEnumCounters() {
+        reset();
+    }
+
+    ShardedEnumCounters(const ShardedEnumCounters&) = delete;
+    ShardedEnumCounters& operator =(const ShardedEnumCounters&) = delete;
+
+    /// Add `amount` to the counter of `item`.
+    void add(Enum item, std::uint64_t amount = 1) {
+        const std::size_t index = to_index(item);
+        m_shards[detail::this_thread_shard() % Shards].counters[index < count ? index : count]
+            .fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    /// Return the total count of `item` across all shards, or zero if
+    /// `item` is not between `BEGIN` and `END`; see `out_of_range()`.
+    std::uint64_t load(Enum item) const {
+        const std::size_t index = to_index(item);
+        if (index >= count) {
+            return 0;
+        }
+        std::uint64_t result = 0;
+        for (const Shard& shard : m_shards) {
+            result += shard.counters[index].load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    /// Return the total count of values that were not items of `Enum`.
+    std::uint64_t out_of_range() const {
+        std::uint64_t result = 0;
+        for (const Shard& shard : m_shards) {
+            result += shard.counters[count].load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    /// Return the total counts of all items.
+    EnumMap<Enum, std::uint64_t> snapshot() const {
+        EnumMap<Enum, std::uint64_t> result;
+        for (const Shard& shard : m_shards) {
+            for (std::size_t i = 0; i < count; ++i) {
+                result.data()[i] += shard.counters[i].load(std::memory_order_relaxed);
+            }
+        }
+        return result;
+    }
+
+    /// Set all counters to zero.
+    void reset() {
+        for (Shard& shard : m_shards) {
+            for (counter_type& counter : shard.counters) {
+                counter.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    /// One copy of the counters, starting on its own cache line; the
+    /// last counter is the spare slot for values that are not items.
+    struct alignas(64) Shard {
+        std::array<counter_type, count + 1> counters;
+    };
+
+    std::array<Shard, Shards> m_shards;
+};
+
+
+/**The process-wide value profile of an `enum`.
+ *
+ * This is what `ENUMERATE_PROFILE` counts into. Its counts can be
+ * ranked with `write_profile_report()`, saved with `write_profile()`,
+ * or turned into a hot order for `PermutedEnumMap` with
+ * `write_hot_order()`.
+ */
+template<typename Enum>
+class EnumProfiler {
+public:
+    /// Count one occurrence of `item` and return it.
+    static Enum record(Enum item) {
+        counters().add(item);
+        return item;
+    }
+
+    /// Return the counts recorded so far.
+    static EnumMap<Enum, std::uint64_t> snapshot() {
+        return counters().snapshot();
+    }
+
+    /// Return the number of recorded values that were not items of `Enum`.
+    static std::uint64_t out_of_range() {
+        return counters().out_of_range();
+    }
+
+    /// Forget all counts recorded so far.
+    static void reset() {
+        counters().reset();
+    }
+
+private:
+    static ShardedEnumCounters<Enum>& counters() {
+        static ShardedEnumCounters<Enum> instance;
+        return instance;
+    }
+};
+
+
+namespace detail {
+
+/// Record `value` with the `EnumProfiler` of its type.
+template<typename Enum>
+Enum profile_value(Enum value) {
+    return EnumProfiler<Enum>::record(value);
+}
+
+/// Return all items, most frequent first; ties keep `enum` order.
+template<typename Enum>
+std::vector<Enum> rank_by_count(const EnumMap<Enum, std::uint64_t>& counts) {
+    std::vector<Enum> result;
+    result.reserve(Enumerate<Enum>::size());
+    for (const Enum item : Enumerate<Enum>{}) {
+        result.push_back(item);
+    }
+    std::stable_sort(result.begin(), result.end(), [&counts](Enum lhs, Enum rhs) {
+        return counts[lhs] > counts[rhs];
+    });
+    return result;
+}
+
+/// Return the registered name of `item`, or its position if it has none.
+template<typename Enum>
+std::string profile_label(Enum item) {
+    if constexpr (has_names<Enum>::value) {
+        return std::string{to_name(item)};
+    } else {
+        return std::to_string(to_index(item));
+    }
+}
+
+/// Return `label` with backslashes and line breaks escaped, so that it
+/// fits on one line of a profile file.
+inline std::string escape_profile_label(const std::string& label) {
+    std::string result;
+    for (const char c : label) {
+        if (c == '\\') {
+            result += "\\\\";
+        } else if (c == '\n') {
+            result += "\\n";
+        } else if (c == '\r') {
+            result += "\\r";
+        } else {
+            result += c;
+        }
+    }
+    return result;
+}
+
+/// Undo `escape_profile_label()`, or return nothing if `text` is malformed.
+inline std::optional<std::string> unescape_profile_label(const std::string& text) {
+    std::string result;
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        if (text[i] != '\\') {
+            result += text[i];
+        } else if (++i == text.size()) {
+            return std::nullopt;
+        } else if (text[i] == '\\') {
+            result += '\\';
+        } else if (text[i] == 'n') {
+            result += '\n';
+        } else if (text[i] == 'r') {
+            result += '\r';
+        } else {
+            return std::nullopt;
+        }
+    }
+    return result;
+}
+
+/// Return the item labelled `label` by `profile_label()`, if there is one.
+template<typename Enum>
+std::optional<Enum> parse_profile_label(const std::string& label) {
+    if constexpr (has_names<Enum>::value) {
+        return parse<Enum>(label);
+    } else {
+        char* end = nullptr;
+        const auto index = std::strtoull(label.c_str(), &end, 10);
+        if (label.empty() || *end != '\0' || index >= Enumerate<Enum>::size()) {
+            return std::nullopt;
+        }
+        return from_index<Enum>(static_cast<std::size_t>(index));
+    }
+}
+
+}
+
+
+/**Write a human-readable report of `counts`, most frequent item first.
+ *
+ * Every item is listed, including those that never occurred, followed
+ * by a summary of how many items were covered.
+ */
+template<typename Enum>
+void write_profile_report(std::ostream& os, const EnumMap<Enum, std::uint64_t>& counts) {
+    std::uint64_t total = 0;
+    std::size_t covered = 0;
+    for (const std::uint64_t count : counts) {
+        total += count;
+        covered += count != 0;
+    }
+    char line[64];
+    os << "rank                count    share   cumul.  item\n";
+    std::uint64_t cumulative = 0;
+    std::size_t rank = 0;
+    for (const Enum item : detail::rank_by_count(counts)) {
+        cumulative += counts[item];
+        const double share = total == 0 ? 0.0 : 100.0 * counts[item] / total;
+        const double cumulative_share = total == 0 ? 0.0 : 100.0 * cumulative / total;
+        std::snprintf(line, sizeof(line), "%4zu %20" PRIu64 "  %6.2f%%  %6.2f%%  ",
+                      ++rank, counts[item], share, cumulative_share);
+        os << line << detail::profile_label(item) << '\n';
+    }
+    os << "covered " << covered << " of " << counts.size() << " items, "
+       << total << " events\n";
+}
+
+
+/**Write `counts` as a profile file, most frequent item first.
+ *
+ * The file is plain text: a few header lines starting with `#`, among
+ * them the `enum`'s `fingerprint()`, then one line per item with its
+ * name (or position, if the `enum` has no registered names), a space
+ * and its count. Names may contain spaces or be empty; backslashes and
+ * line breaks in them are escaped. It can be read back with
+ * `read_profile()`.
+ */
+template<typename Enum>
+void write_profile(std::ostream& os, const EnumMap<Enum, std::uint64_t>& counts) {
+    char line[64];
+    std::snprintf(line, sizeof(line), "# fingerprint %016" PRIx64 "\n", fingerprint<Enum>());
+    os << "# enumerate profile 1\n" << line;
+    for (const Enum item : detail::rank_by_count(counts)) {
+        os << detail::escape_profile_label(detail::profile_label(item)) << ' '
+           << counts[item] << '\n';
+    }
+}
+
+
+/**Read a profile file written by `write_profile()`.
+ *
+ * Items that are missing from the file count as zero.
+ *
+ * \throws SerializationError if the file is malformed, was written for
+ *         a different `enum` layout or names an unknown item.
+ */
+template<typename Enum>
+EnumMap<Enum, std::uint64_t> read_profile(std::istream& is) {
+    std::string line;
+    if (!std::getline(is, line) || line != "# enumerate profile 1") {
+        throw SerializationError("enumerate: not a profile file");
+    }
+    char expected[40];
+    std::snprintf(expected, sizeof(expected), "# fingerprint %016" PRIx64, fingerprint<Enum>());
+    if (!std::getline(is, line) || line != expected) {
+        throw SerializationError("enumerate: profile does not match enum layout");
+    }
+    EnumMap<Enum, std::uint64_t> result;
+    while (std::getline(is, line)) {
+        // The count follows the last space; the label is everything before it.
+        const std::size_t space = line.rfind(' ');
+        if (space == std::string::npos || space + 1 == line.size()
+            || line.find_first_not_of("0123456789", space + 1) != std::string::npos) {
+            throw SerializationError("enumerate: malformed profile");
+        }
+        errno = 0;
+        const std::uint64_t count = std::strtoull(line.c_str() + space + 1, nullptr, 10);
+        const auto label = detail::unescape_profile_label(line.substr(0, space));
+        if (errno == ERANGE || !label) {
+            throw SerializationError("enumerate: malformed profile");
+        }
+        const auto item = detail::parse_profile_label<Enum>(*label);
+        if (!item) {
+            throw SerializationError("enumerate: profile names unknown item");
+        }
+        result[*item] = count;
+    }
+    return result;
+}
+
+
+/**Return the most frequent items that together make up `coverage`.
+ *
+ * The result is ordered by frequency and holds at least one item.
+ * `coverage` is a fraction of all events, e.g. `0.99`.
+ */
+template<typename Enum>
+std::vector<Enum> hot_order(const EnumMap<Enum, std::uint64_t>& counts, double coverage = 0.99) {
+    std::uint64_t total = 0;
+    for (const std::uint64_t count : counts) {
+        total += count;
+    }
+    std::vector<Enum> ranked = detail::rank_by_count(counts);
+    std::uint64_t cumulative = 0;
+    std::size_t hot = 0;
+    while (hot < ranked.size() && counts[ranked[hot]] != 0
+           && static_cast<double>(cumulative) < coverage * static_cast<double>(total)) {
+        cumulative += counts[ranked[hot++]];
+    }
+    ranked.resize(std::min(ranked.size(), std::max<std::size_t>(hot, 1)));
+    return ranked;
+}
+
+
+/**Write a profile struct for `PermutedEnumMap` as C++ source.
+ *
+ * `enum_name` is the qualified name of `Enum` as it should appear in
+ * the source, and `struct_name` is the name of the generated struct.
+ * The hot order is computed by `hot_order(counts, coverage)`.
+ *
+ * Registered names need not be the enumerators' identifiers, so items
+ * are written by position as `enumerate::from_index<Enum>(i)`, followed
+ * by their name in a comment.
+ */
+template<typename Enum>
+void write_hot_order(std::ostream& os, const EnumMap<Enum, std::uint64_t>& counts,
+                     const std::string& enum_name, const std::string& struct_name,
+                     double coverage = 0.99) {
+    os << "struct " << struct_name << " {\n"
+       << "    static constexpr " << enum_name << " hot[] = {\n";
+    for (const Enum item : hot_order(counts, coverage)) {
+        os << "        enumerate::from_index<" << enum_name << ">(" << to_index(item) << "),";
+        if constexpr (has_names<Enum>::value) {
+            const std::string name{to_name(item)};
+            // Leave out names that could end or continue the comment.
+            const bool printable = std::all_of(name.begin(), name.end(), [](char c) {
+                return c >= ' ' && c <= '~';
+            });
+            if (printable && (name.empty() || name.back() != '\\')) {
+                os << "  // " << name;
+            }
+        }
+        os << '\n';
+    }
+    os << "    };\n};\n";
+}
+
+}
+
+#endif // ENUMERATE_PROFILER_HPP
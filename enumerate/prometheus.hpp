@@ -0,0 +1,226 @@
+/*
+ * enumerate/prometheus.hpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Nico Madysa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENUMERATE_PROMETHEUS_HPP
+#define ENUMERATE_PROMETHEUS_HPP
+
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "../enumerate.hpp"
+#include "containers.hpp"
+#include "names.hpp"
+
+
+namespace enumerate {
+
+/// The metric types of the Prometheus text exposition format.
+enum class MetricType {
+    Counter,
+    Gauge,
+    Untyped,
+};
+
+
+/**A Prometheus metric family with one series per item of an `enum`.
+ *
+ * All text that does not depend on the values -- the `# HELP` and
+ * `# TYPE` lines and every `metric{label="Item"} ` prefix -- is
+ * rendered once, when the family is constructed, into one contiguous
+ * buffer. A scrape then only copies those prefixes and formats the
+ * numbers with `std::to_chars`; it does not allocate as long as the
+ * output buffer is reused.
+ *
+ * ```
+ * const PrometheusFamily<Fruit> family{
+ *     "fruit_sold_total", "fruit", "Pieces of fruit sold."};
+ * std::string scrape;
+ * family.render(counters, scrape);
+ * ```
+ * yields
+ * ```
+ * # HELP fruit_sold_total Pieces of fruit sold.
+ * # TYPE fruit_sold_total counter
+ * fruit_sold_total{fruit="Apple"} 3
+ * fruit_sold_total{fruit="Orange"} 0
+ * fruit_sold_total{fruit="Pear"} 7
+ * ```
+ */
+template<typename Enum>
+class PrometheusFamily {
+public:
+    /// Number of series, i.e. the number of items in `Enum`.
+    static constexpr std::size_t count = NamePool<Enum>::count;
+
+    /// Upper bound on the characters that `std::to_chars` emits for a value.
+    static constexpr std::size_t max_value_size = 32;
+
+    /**Pre-render the family.
+     *
+     * \param metric the metric name, used verbatim.
+     * \param label the name of the label that holds the item names.
+     * \param help the text of the `# HELP` line; omitted if empty.
+     * \param type the metric type announced in the `# TYPE` line.
+     */
+    PrometheusFamily(
+        std::string_view metric, std::string_view label,
+        std::string_view help = {}, MetricType type = MetricType::Counter
+    ) {
+        if (!help.empty()) {
+            m_text.append("# HELP ").append(metric).append(" ");
+            append_escaped(m_text, help, false);
+            m_text.append("\n");
+        }
+        m_text.append("# TYPE ").append(metric).append(" ").append(type_name(type)).append("\n");
+        m_preamble_size = m_text.size();
+        m_offsets.reserve(count + 1);
+        for (std::size_t i = 0; i < count; ++i) {
+            m_offsets.push_back(static_cast<std::uint32_t>(m_text.size()));
+            m_text.append(metric).append("{").append(label).append("=\"");
+            append_escaped(m_text, NamePool<Enum>::name_at(i), true);
+            m_text.append("\"} ");
+        }
+        m_offsets.push_back(static_cast<std::uint32_t>(m_text.size()));
+    }
+
+    /// Return the number of characters that `render()` writes at most.
+    std::size_t max_size() const {
+        return m_text.size() + count * (max_value_size + 1);
+    }
+
+    /**Write the exposition text for `values` to `out` and return its end.
+     *
+     * `out` must have room for at least `max_size()` characters.
+     */
+    template<typename T>
+    char* render(const EnumMap<Enum, T>& values, char* out) const {
+        static_assert_value_type<T>();
+        const char* const text = m_text.data();
+        std::memcpy(out, text, m_preamble_size);
+        out += m_preamble_size;
+        for (std::size_t i = 0; i < count; ++i) {
+            const std::size_t prefix_size = m_offsets[i + 1] - m_offsets[i];
+            std::memcpy(out, text + m_offsets[i], prefix_size);
+            out += prefix_size;
+            out = write_value(out, values.data()[i]);
+            *out++ = '\n';
+        }
+        return out;
+    }
+
+    /**Append the exposition text for `values` to `out`.
+     *
+     * This only allocates if `out` lacks the capacity for `max_size()`
+     * more characters, so clearing and reusing the same string across
+     * scrapes keeps them allocation-free.
+     */
+    template<typename T>
+    void render(const EnumMap<Enum, T>& values, std::string& out) const {
+        static_assert_value_type<T>();
+        // Appending avoids zero-filling `max_size()` characters first.
+        out.reserve(out.size() + max_size());
+        out.append(m_text.data(), m_preamble_size);
+        for (std::size_t i = 0; i < count; ++i) {
+            out.append(m_text.data() + m_offsets[i], m_offsets[i + 1] - m_offsets[i]);
+            char value[max_value_size];
+            const char* const value_end = write_value(value, values.data()[i]);
+            out.append(value, static_cast<std::size_t>(value_end - value));
+            out.push_back('\n');
+        }
+    }
+
+private:
+    template<typename T>
+    static constexpr void static_assert_value_type() {
+        static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value,
+                      "values must be numbers");
+    }
+
+    /// Write `value` to `out` and return its end; non-finite values are
+    /// spelled `NaN`, `+Inf` and `-Inf`, as the format requires.
+    template<typename T>
+    static char* write_value(char* out, T value) {
+        if constexpr (std::is_floating_point<T>::value) {
+            if (std::isnan(value)) {
+                std::memcpy(out, "NaN", 3);
+                return out + 3;
+            }
+            if (std::isinf(value)) {
+                std::memcpy(out, value > 0 ? "+Inf" : "-Inf", 4);
+                return out + 4;
+            }
+        }
+        return std::to_chars(out, out + max_value_size, value).ptr;
+    }
+
+    static const char* type_name(MetricType type) {
+        switch (type) {
+        case MetricType::Counter:
+            return "counter";
+        case MetricType::Gauge:
+            return "gauge";
+        default:
+            return "untyped";
+        }
+    }
+
+    /// Escape backslashes, line feeds and, in label values, double quotes.
+    static void append_escaped(std::string& out, std::string_view text, bool quote) {
+        for (const char c : text) {
+            if (c == '\\') {
+                out.append("\\\\");
+            } else if (c == '\n') {
+                out.append("\\n");
+            } else if (c == '"' && quote) {
+                out.append("\\\"");
+            } else {
+                out.push_back(c);
+            }
+        }
+    }
+
+    /// The pre-rendered preamble followed by all series prefixes.
+    std::string m_text;
+
+    /// Length of the `# HELP` and `# TYPE` lines.
+    std::size_t m_preamble_size = 0;
+
+    /// Start of each series prefix in `m_text`, plus its total length.
+    std::vector<std::uint32_t> m_offsets;
+};
+
+}
+
+#endif // ENUMERATE_PROMETHEUS_HPP
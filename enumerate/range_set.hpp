@@ -0,0 +1,288 @@
+/*
+ * enumerate/range_set.hpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Nico Madysa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENUMERATE_RANGE_SET_HPP
+#define ENUMERATE_RANGE_SET_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+#include "../enumerate.hpp"
+#include "containers.hpp"
+#include "permuted_map.hpp"
+
+
+namespace enumerate {
+
+/**A set of items of an `enum`, stored as sorted runs of adjacent items.
+ *
+ * The set keeps the boundaries of its runs in one sorted array: run
+ * `r` covers the half-open range of positions `[bounds[2r],
+ * bounds[2r + 1])`. A set of `R` runs takes `2R` integers no wider than
+ * needed for the `enum`'s size, whatever that size is, which makes it
+ * much smaller than an `EnumSet` for large `enum`s whose subsets are a
+ * few contiguous blocks.
+ *
+ * Membership is a binary search over the boundaries. Union and
+ * intersection merge the boundaries of both sets in one pass. Updates
+ * that split or join runs move the boundaries behind them.
+ *
+ * ```
+ * auto vector_ops = EnumRangeSet<Opcode>::range(Opcode::VAddFirst, Opcode::VAddEnd);
+ * vector_ops.insert(Opcode::VMulFirst, Opcode::VMulEnd);
+ * if (vector_ops.contains(op)) { ... }
+ * ```
+ */
+template<typename Enum>
+class EnumRangeSet {
+public:
+    /// `Enum`.
+    using value_type = Enum;
+
+    /// Number of items in `Enum`.
+    static constexpr std::size_t universe_size = Enumerate<Enum>::size();
+
+    /// The type of a single boundary.
+    using bound_type = detail::slot_index_t<universe_size>;
+
+    /// A forward iterator over the items in the set, in `enum` order.
+    class const_iterator {
+    public:
+        using value_type = Enum;
+
+        const_iterator(const EnumRangeSet* set, std::size_t run)
+            : m_set(set), m_run(run), m_item(set->run_begin(run)) {}
+
+        /// Return the current item.
+        constexpr Enum operator *() const { return *m_item; }
+
+        /// Advance to the next item in the set.
+        const_iterator& operator ++() {
+            ++m_item;
+            if (m_item == EnumIter<Enum>{m_set->run_end(m_run)}) {
+                ++m_run;
+                m_item = EnumIter<Enum>{m_set->run_begin(m_run)};
+            }
+            return *this;
+        }
+
+        bool operator ==(const const_iterator& rhs) const { return m_item == rhs.m_item; }
+        bool operator !=(const const_iterator& rhs) const { return m_item != rhs.m_item; }
+
+    private:
+        const EnumRangeSet* m_set;
+        std::size_t m_run;
+        EnumIter<Enum> m_item;
+    };
+
+    /// Create an empty set.
+    EnumRangeSet() = default;
+
+    /// Create a set that contains `items`.
+    EnumRangeSet(std::initializer_list<Enum> items) {
+        for (const Enum item : items) {
+            insert(item);
+        }
+    }
+
+    /// Create a set that contains the items of `set`.
+    explicit EnumRangeSet(const EnumSet<Enum>& set) {
+        std::size_t last = universe_size;
+        for (const Enum item : set) {
+            const std::size_t index = to_index(item);
+            if (index != last) {
+                m_bounds.push_back(static_cast<bound_type>(index));
+                m_bounds.push_back(static_cast<bound_type>(index + 1));
+            } else {
+                m_bounds.back() = static_cast<bound_type>(index + 1);
+            }
+            last = index + 1;
+        }
+    }
+
+    /// Return a set that contains the items in `[first, last)`.
+    static EnumRangeSet range(Enum first, Enum last) {
+        EnumRangeSet result;
+        result.insert(first, last);
+        return result;
+    }
+
+    /// Return a set that contains every item of `Enum`.
+    static EnumRangeSet all() {
+        return range(Enumerate<Enum>::begin_value, Enumerate<Enum>::end_value);
+    }
+
+    /// Return `true` if `item` is in the set.
+    bool contains(Enum item) const {
+        const std::size_t index = to_index(item);
+        if (index >= universe_size) {
+            return false;
+        }
+        // Inside a run, an odd number of boundaries is at or before `index`.
+        const auto it = std::upper_bound(m_bounds.begin(), m_bounds.end(), index);
+        return (it - m_bounds.begin()) % 2 == 1;
+    }
+
+    /// Add `item` to the set.
+    void insert(Enum item) { assign(to_index(item), to_index(item) + 1, true); }
+
+    /// Add the items in `[first, last)` to the set.
+    void insert(Enum first, Enum last) { assign(to_index(first), to_index(last), true); }
+
+    /// Remove `item` from the set.
+    void erase(Enum item) { assign(to_index(item), to_index(item) + 1, false); }
+
+    /// Remove the items in `[first, last)` from the set.
+    void erase(Enum first, Enum last) { assign(to_index(first), to_index(last), false); }
+
+    /// Remove all items from the set.
+    void clear() { m_bounds.clear(); }
+
+    /// Return the number of items in the set.
+    std::size_t size() const {
+        std::size_t result = 0;
+        for (std::size_t i = 0; i < m_bounds.size(); i += 2) {
+            result += m_bounds[i + 1] - m_bounds[i];
+        }
+        return result;
+    }
+
+    /// Return `true` if the set contains no items.
+    bool empty() const { return m_bounds.empty(); }
+
+    /// Return the number of runs of adjacent items.
+    std::size_t run_count() const { return m_bounds.size() / 2; }
+
+    /// Return the half-open range of items covered by run `r`.
+    std::pair<Enum, Enum> run(std::size_t r) const { return {run_begin(r), run_end(r)}; }
+
+    /// Add all items of `other` to this set.
+    EnumRangeSet& operator |=(const EnumRangeSet& other) {
+        m_bounds = merge(m_bounds, other.m_bounds, [](bool a, bool b) { return a || b; });
+        return *this;
+    }
+
+    /// Remove all items from this set that are not in `other`.
+    EnumRangeSet& operator &=(const EnumRangeSet& other) {
+        m_bounds = merge(m_bounds, other.m_bounds, [](bool a, bool b) { return a && b; });
+        return *this;
+    }
+
+    friend EnumRangeSet operator |(EnumRangeSet lhs, const EnumRangeSet& rhs) { return lhs |= rhs; }
+    friend EnumRangeSet operator &(EnumRangeSet lhs, const EnumRangeSet& rhs) { return lhs &= rhs; }
+
+    /// Sets are equal if they contain the same items.
+    bool operator ==(const EnumRangeSet& rhs) const { return m_bounds == rhs.m_bounds; }
+    bool operator !=(const EnumRangeSet& rhs) const { return m_bounds != rhs.m_bounds; }
+
+    /// Iterate over the items in the set, in `enum` order.
+    const_iterator begin() const { return const_iterator{this, 0}; }
+    const_iterator end() const { return const_iterator{this, run_count()}; }
+
+    /// Return the items of the set as an `EnumSet`.
+    EnumSet<Enum> to_set() const {
+        EnumSet<Enum> result;
+        for (const Enum item : *this) {
+            result.insert(item);
+        }
+        return result;
+    }
+
+    /// Release memory that is no longer needed after updates.
+    void shrink_to_fit() { m_bounds.shrink_to_fit(); }
+
+private:
+    /// Return the first item of run `r`, or `END` past the last run.
+    Enum run_begin(std::size_t r) const {
+        return from_index<Enum>(r < run_count() ? m_bounds[2 * r] : universe_size);
+    }
+
+    /// Return the item after run `r`, or `END` past the last run.
+    Enum run_end(std::size_t r) const {
+        return from_index<Enum>(r < run_count() ? m_bounds[2 * r + 1] : universe_size);
+    }
+
+    /// Make the positions in `[first, last)` members if `member`, else non-members.
+    void assign(std::size_t first, std::size_t last, bool member) {
+        last = std::min(last, universe_size);
+        if (first >= last) {
+            return;
+        }
+        // Boundaries strictly inside the range vanish; the range's own
+        // ends become boundaries wherever membership changes there.
+        const auto lo = std::lower_bound(m_bounds.begin(), m_bounds.end(), first);
+        const auto hi = std::upper_bound(m_bounds.begin(), m_bounds.end(), last);
+        const bool before = (lo - m_bounds.begin()) % 2 == 1;
+        const bool after = (hi - m_bounds.begin()) % 2 == 1;
+        bound_type replacement[2];
+        std::size_t count = 0;
+        if (before != member) {
+            replacement[count++] = static_cast<bound_type>(first);
+        }
+        if (after != member) {
+            replacement[count++] = static_cast<bound_type>(last);
+        }
+        const auto pos = m_bounds.erase(lo, hi);
+        m_bounds.insert(pos, replacement, replacement + count);
+    }
+
+    /// Return the boundaries of the positions where `op(in a, in b)` holds.
+    template<typename Op>
+    static std::vector<bound_type> merge(const std::vector<bound_type>& a,
+                                         const std::vector<bound_type>& b, Op op) {
+        std::vector<bound_type> result;
+        result.reserve(a.size() + b.size());
+        std::size_t i = 0;
+        std::size_t j = 0;
+        bool inside = false;
+        while (i < a.size() || j < b.size()) {
+            // Sweep to the next boundary of either set, and toggle the
+            // membership of each set whose boundary lies there.
+            const std::size_t at = std::min<std::size_t>(
+                i < a.size() ? a[i] : universe_size, j < b.size() ? b[j] : universe_size);
+            i += i < a.size() && a[i] == at;
+            j += j < b.size() && b[j] == at;
+            const bool now = op(i % 2 == 1, j % 2 == 1);
+            if (now != inside) {
+                result.push_back(static_cast<bound_type>(at));
+                inside = now;
+            }
+        }
+        return result;
+    }
+
+    /// Sorted boundaries; run `r` is `[m_bounds[2r], m_bounds[2r + 1])`.
+    std::vector<bound_type> m_bounds;
+};
+
+}
+
+#endif // ENUMERATE_RANGE_SET_HPP
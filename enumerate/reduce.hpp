@@ -0,0 +1,241 @@
+/*
+ * enumerate/reduce.hpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Nico Madysa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENUMERATE_REDUCE_HPP
+#define ENUMERATE_REDUCE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <optional>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "../enumerate.hpp"
+
+
+namespace enumerate {
+
+namespace detail {
+
+/**Reduces the leaves `[0, size)` along a fixed binary tree.
+ *
+ * A range is split at its midpoint until single leaves remain, so the
+ * order in which `combine` sees values depends only on `size`. Threads
+ * evaluate whole subtrees at a fixed depth and the calling thread
+ * combines their results along the same tree; the number of threads
+ * therefore decides who evaluates a node, never which nodes exist.
+ */
+template<typename T, typename Leaf, typename Combine>
+class TreeReduction {
+public:
+    TreeReduction(std::size_t size, const Leaf& leaf, const Combine& combine)
+        : m_size(size), m_leaf(leaf), m_combine(combine) {}
+
+    /// Return the root of the tree; `size` must not be zero.
+    T run(std::size_t threads) {
+        // Aim for a few subtrees per thread to even out their cost.
+        std::size_t depth = 0;
+        while (threads > 1 && (std::size_t{1} << depth) < 4 * threads
+               && (m_size >> depth) > 1) {
+            ++depth;
+        }
+        if (depth == 0) {
+            return reduce(0, m_size);
+        }
+        collect(0, m_size, depth);
+        m_results.resize(m_tasks.size());
+        run_tasks(std::min(threads, m_tasks.size()));
+        std::size_t next = 0;
+        return gather(0, m_size, depth, next);
+    }
+
+private:
+    /// Reduce the subtree over `[begin, end)` on the calling thread.
+    T reduce(std::size_t begin, std::size_t end) const {
+        if (end - begin == 1) {
+            return m_leaf(begin);
+        }
+        const std::size_t mid = begin + (end - begin) / 2;
+        T left = reduce(begin, mid);
+        return m_combine(std::move(left), reduce(mid, end));
+    }
+
+    /// Append the subtrees `depth` levels below `[begin, end)` to `m_tasks`.
+    void collect(std::size_t begin, std::size_t end, std::size_t depth) {
+        if (depth == 0 || end - begin == 1) {
+            m_tasks.emplace_back(begin, end);
+            return;
+        }
+        const std::size_t mid = begin + (end - begin) / 2;
+        collect(begin, mid, depth - 1);
+        collect(mid, end, depth - 1);
+    }
+
+    /// Combine the results of `m_tasks` along the tree, mirroring `collect()`.
+    T gather(std::size_t begin, std::size_t end, std::size_t depth, std::size_t& next) {
+        if (depth == 0 || end - begin == 1) {
+            return std::move(*m_results[next++]);
+        }
+        const std::size_t mid = begin + (end - begin) / 2;
+        T left = gather(begin, mid, depth - 1, next);
+        return m_combine(std::move(left), gather(mid, end, depth - 1, next));
+    }
+
+    /// Evaluate all of `m_tasks` on `threads` threads, including this one.
+    void run_tasks(std::size_t threads) {
+        std::atomic<std::size_t> next_task{0};
+        std::exception_ptr error;
+        std::atomic<bool> failed{false};
+        auto work = [&] {
+            for (std::size_t task = next_task++; task < m_tasks.size(); task = next_task++) {
+                if (failed.load(std::memory_order_relaxed)) {
+                    return;
+                }
+                try {
+                    m_results[task].emplace(reduce(m_tasks[task].first, m_tasks[task].second));
+                } catch (...) {
+                    if (!failed.exchange(true)) {
+                        error = std::current_exception();
+                    }
+                    return;
+                }
+            }
+        };
+        std::vector<std::thread> workers;
+        for (std::size_t i = 1; i < threads; ++i) {
+            workers.emplace_back(work);
+        }
+        work();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    std::size_t m_size;
+    const Leaf& m_leaf;
+    const Combine& m_combine;
+    std::vector<std::pair<std::size_t, std::size_t>> m_tasks;
+    std::vector<std::optional<T>> m_results;
+};
+
+
+/// Return `threads`, or the number of hardware threads if it is zero.
+inline std::size_t resolve_threads(std::size_t threads) {
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    return std::max<std::size_t>(threads, 1);
+}
+
+
+/// Return the items of `Enums...` at position `index` of their product.
+template<typename... Enums, std::size_t... I>
+std::tuple<Enums...> product_items(std::size_t index, std::index_sequence<I...>) {
+    constexpr std::size_t sizes[] = {Enumerate<Enums>::size()...};
+    std::size_t digits[sizeof...(Enums)];
+    // The last `enum` varies fastest, like the indices of a C array.
+    for (std::size_t i = sizeof...(Enums); i-- > 0;) {
+        digits[i] = index % sizes[i];
+        index /= sizes[i];
+    }
+    return std::tuple<Enums...>{from_index<Enums>(digits[I])...};
+}
+
+}
+
+
+/**Reduce `map(item)` over all items of `Enum` in parallel.
+ *
+ * Values are combined along a fixed binary tree over the items in
+ * `enum` order, independently of the number of threads and of their
+ * scheduling. With a deterministic `map` and `combine`, the result is
+ * bit-identical on any number of threads, which also holds for
+ * floating-point sums that are not associative. `identity` is only
+ * returned for an empty `enum`; it never enters the tree.
+ *
+ * `threads` is the number of threads to use, including the calling
+ * thread; zero uses every hardware thread. Both `map` and `combine` must
+ * be safe to call concurrently. An exception thrown by either is
+ * rethrown after all threads have stopped.
+ *
+ * ```
+ * const double total = parallel_reduce<Category>(
+ *     0.0, [&](Category c) { return sum_of(c); }, std::plus<>{});
+ * ```
+ */
+template<typename Enum, typename T, typename Map, typename Combine>
+T parallel_reduce(T identity, const Map& map, const Combine& combine,
+                  std::size_t threads = 0) {
+    constexpr std::size_t size = Enumerate<Enum>::size();
+    if (size == 0) {
+        return identity;
+    }
+    auto leaf = [&map](std::size_t index) -> T { return map(from_index<Enum>(index)); };
+    return detail::TreeReduction<T, decltype(leaf), Combine>{size, leaf, combine}
+        .run(detail::resolve_threads(threads));
+}
+
+
+/**Reduce `map(items...)` over the product of several `enum`s in parallel.
+ *
+ * The tuples of items are ordered like the indices of a C array, i.e.
+ * the last `enum` varies fastest, and are reduced along a fixed tree
+ * exactly as by the single-`enum` overload:
+ *
+ * ```
+ * const double total = parallel_reduce<Region, Product>(
+ *     0.0, [&](Region r, Product p) { return revenue[r][p]; }, std::plus<>{});
+ * ```
+ */
+template<typename Enum1, typename Enum2, typename... Enums,
+         typename T, typename Map, typename Combine>
+T parallel_reduce(T identity, const Map& map, const Combine& combine,
+                  std::size_t threads = 0) {
+    constexpr std::size_t size =
+        Enumerate<Enum1>::size() * Enumerate<Enum2>::size() * (Enumerate<Enums>::size() * ... * 1);
+    if (size == 0) {
+        return identity;
+    }
+    auto leaf = [&map](std::size_t index) -> T {
+        return std::apply(map, detail::product_items<Enum1, Enum2, Enums...>(
+            index, std::make_index_sequence<2 + sizeof...(Enums)>{}));
+    };
+    return detail::TreeReduction<T, decltype(leaf), Combine>{size, leaf, combine}
+        .run(detail::resolve_threads(threads));
+}
+
+}
+
+#endif // ENUMERATE_REDUCE_HPP
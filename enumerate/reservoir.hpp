@@ -0,0 +1,196 @@
+/*
+ * enumerate/reservoir.hpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Nico Madysa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENUMERATE_RESERVOIR_HPP
+#define ENUMERATE_RESERVOIR_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+
+#include "../enumerate.hpp"
+#include "containers.hpp"
+
+
+namespace enumerate {
+
+/**Keeps a uniform random sample of fixed size per item of an `enum`.
+ *
+ * Each item owns a reservoir of `capacity()` values, and all reservoirs
+ * share one slab that is allocated when the sampler is created. Once
+ * an item's reservoir is full, every value of that item seen so far is
+ * in it with the same probability, however many values other items
+ * have. Rare items therefore keep samples of their own instead of being
+ * drowned out by frequent ones.
+ *
+ * Replacement follows Li's Algorithm L: after each replacement, the
+ * number of values to pass over until the next one is drawn up front.
+ * Most values thus cost a single decrement of their item's counter,
+ * and the random number generator is only used about
+ * `capacity * log(seen / capacity)` times per item.
+ *
+ * ```
+ * StratifiedReservoir<RequestType, Request> samples{32};
+ * samples.add_by(batch.begin(), batch.end(), [](const Request& r) { return r.type; });
+ * for (std::size_t i = 0; i < samples.size(RequestType::Login); ++i) {
+ *     inspect(samples.sample(RequestType::Login)[i]);
+ * }
+ * ```
+ */
+template<typename Enum, typename T>
+class StratifiedReservoir {
+    static_assert(std::is_default_constructible<T>::value && std::is_copy_assignable<T>::value,
+                  "sampled values must be default-constructible and copy-assignable");
+
+public:
+    /// Number of reservoirs, i.e. the number of items in `Enum`.
+    static constexpr std::size_t count = Enumerate<Enum>::size();
+
+    /**Create a sampler that keeps up to `capacity` values per item.
+     *
+     * \throws std::invalid_argument if `capacity` is zero.
+     * \throws std::length_error if the slab of `count * capacity` values
+     *         cannot be addressed.
+     */
+    explicit StratifiedReservoir(std::size_t capacity, std::uint64_t seed = 5489u)
+        : m_capacity(checked_capacity(capacity)),
+          m_slab(new T[count * capacity]),
+          m_random(seed) {}
+
+    /// Offer `value` to the reservoir of `key`.
+    void add(Enum key, const T& value) {
+        Stratum& stratum = m_strata[key];
+        ++stratum.seen;
+        if (stratum.skip != 0) {
+            --stratum.skip;
+            return;
+        }
+        accept(key, stratum, value);
+    }
+
+    /// Offer `values[i]` to the reservoir of `keys[i]` for all `i < size`.
+    void add(const Enum* keys, const T* values, std::size_t size) {
+        for (std::size_t i = 0; i < size; ++i) {
+            add(keys[i], values[i]);
+        }
+    }
+
+    /// Offer every value in `[first, last)` to the reservoir of `key_of(value)`.
+    template<typename It, typename KeyOf>
+    void add_by(It first, It last, KeyOf key_of) {
+        for (; first != last; ++first) {
+            add(key_of(*first), *first);
+        }
+    }
+
+    /// Return the number of values kept for `key`, at most `capacity()`.
+    std::size_t size(Enum key) const {
+        const std::uint64_t seen = m_strata[key].seen;
+        return seen < m_capacity ? static_cast<std::size_t>(seen) : m_capacity;
+    }
+
+    /// Return the values kept for `key`; there are `size(key)` of them.
+    const T* sample(Enum key) const { return m_slab.get() + to_index(key) * m_capacity; }
+
+    /// Return the number of values ever offered for `key`.
+    std::uint64_t seen(Enum key) const { return m_strata[key].seen; }
+
+    /// Return the largest number of values kept per item.
+    std::size_t capacity() const { return m_capacity; }
+
+    /// Forget all values; the slab stays allocated.
+    void clear() { m_strata = EnumMap<Enum, Stratum>{}; }
+
+private:
+    /// Return `capacity` if it is valid for a sampler.
+    static std::size_t checked_capacity(std::size_t capacity) {
+        if (capacity == 0) {
+            throw std::invalid_argument(
+                "enumerate::StratifiedReservoir: capacity must not be zero");
+        }
+        if (capacity > std::numeric_limits<std::size_t>::max() / sizeof(T) / count) {
+            throw std::length_error("enumerate::StratifiedReservoir: capacity too large");
+        }
+        return capacity;
+    }
+
+    /// The state of the reservoir of one item.
+    struct Stratum {
+        /// Number of values offered.
+        std::uint64_t seen = 0;
+
+        /// Number of values to pass over before the next one is kept.
+        std::uint64_t skip = 0;
+
+        /// Algorithm L's running weight; the largest of `capacity`
+        /// uniform keys, each raised to the power `1 / capacity`.
+        double weight = 0.0;
+    };
+
+    /// Keep `value`, which has just been counted in `stratum.seen`.
+    void accept(Enum key, Stratum& stratum, const T& value) {
+        T* reservoir = m_slab.get() + to_index(key) * m_capacity;
+        if (stratum.seen <= m_capacity) {
+            reservoir[stratum.seen - 1] = value;
+            if (stratum.seen < m_capacity) {
+                return;
+            }
+            // The reservoir is full; start skipping.
+            stratum.weight = std::exp(std::log(uniform()) / static_cast<double>(m_capacity));
+        } else {
+            reservoir[std::uniform_int_distribution<std::size_t>{0, m_capacity - 1}(m_random)] = value;
+            stratum.weight *= std::exp(std::log(uniform()) / static_cast<double>(m_capacity));
+        }
+        stratum.skip = draw_skip(stratum.weight);
+    }
+
+    /// Return the number of values to pass over at `weight`.
+    std::uint64_t draw_skip(double weight) {
+        const double skip = std::floor(std::log(uniform()) / std::log1p(-weight));
+        // Tiny weights give astronomically long skips; cap them.
+        return skip < 1.8e19 ? static_cast<std::uint64_t>(skip)
+                             : std::numeric_limits<std::uint64_t>::max();
+    }
+
+    /// Return a uniform random number in `(0, 1]`.
+    double uniform() { return 1.0 - static_cast<double>(m_random() >> 11) * 0x1.0p-53; }
+
+    std::size_t m_capacity;
+    std::unique_ptr<T[]> m_slab;
+    EnumMap<Enum, Stratum> m_strata;
+    std::mt19937_64 m_random;
+};
+
+}
+
+#endif // ENUMERATE_RESERVOIR_HPP
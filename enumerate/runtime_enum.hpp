@@ -0,0 +1,339 @@
+/*
+ * enumerate/runtime_enum.hpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Nico Madysa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENUMERATE_RUNTIME_ENUM_HPP
+#define ENUMERATE_RUNTIME_ENUM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "containers.hpp"
+#include "names.hpp"
+
+
+namespace enumerate {
+
+/// An item of a `RuntimeEnum`, i.e. a dense id from zero to `size() - 1`.
+enum class RuntimeItem : std::uint32_t {};
+
+
+/// A forward iterator over the items of a `RuntimeEnum`.
+class RuntimeEnumIter {
+public:
+    using value_type = RuntimeItem;
+
+    constexpr explicit RuntimeEnumIter(std::uint32_t index) noexcept
+        : m_index(index)
+    {}
+
+    /// Return the current item.
+    constexpr RuntimeItem operator *() const { return RuntimeItem{m_index}; }
+
+    /// Advance to the next item.
+    RuntimeEnumIter& operator ++() {
+        ++m_index;
+        return *this;
+    }
+
+    constexpr bool operator ==(RuntimeEnumIter rhs) const { return m_index == rhs.m_index; }
+    constexpr bool operator !=(RuntimeEnumIter rhs) const { return m_index != rhs.m_index; }
+
+private:
+    std::uint32_t m_index;
+};
+
+
+/**An enumeration whose items are defined at run time.
+ *
+ * This is the run-time counterpart of an `enum` with registered names.
+ * A list of names, e.g. read from a configuration file at startup, is
+ * interned into dense ids. Afterwards, the set of items is fixed and
+ * supports the same operations: iteration, name lookup, a hashed
+ * `parse()` and dense containers (`RuntimeEnumMap`, `RuntimeEnumSet`).
+ *
+ * ```
+ * const RuntimeEnum regions{"eu-west", "us-east", "ap-south"};
+ * RuntimeEnumMap<std::uint64_t> hits{regions};
+ * if (const auto region = regions.parse(token)) {
+ *     ++hits[*region];
+ * }
+ * ```
+ */
+class RuntimeEnum {
+public:
+    /// The type of items.
+    using value_type = RuntimeItem;
+
+    /// The corresponding forwards iterator.
+    using iterator = RuntimeEnumIter;
+
+    /// Create an enumeration without items.
+    RuntimeEnum() { build_table(); }
+
+    /// Intern `names` in order.
+    /// \throws std::invalid_argument if a name occurs twice.
+    RuntimeEnum(std::initializer_list<std::string_view> names)
+        : RuntimeEnum(names.begin(), names.end())
+    {}
+
+    /// Intern the names in `[first, last)` in order.
+    /// \throws std::invalid_argument if a name occurs twice.
+    template<typename It>
+    RuntimeEnum(It first, It last) {
+        for (; first != last; ++first) {
+            const std::string_view name{*first};
+            m_offsets.push_back(static_cast<std::uint32_t>(m_pool.size()));
+            m_pool.append(name.data(), name.size());
+        }
+        m_offsets.push_back(static_cast<std::uint32_t>(m_pool.size()));
+        build_table();
+    }
+
+    /// Return the number of items.
+    std::size_t size() const { return m_offsets.size() - 1; }
+
+    /// Return an iterator to the first item.
+    iterator begin() const { return iterator{0}; }
+
+    /// Return an iterator past the last item.
+    iterator end() const { return iterator{static_cast<std::uint32_t>(size())}; }
+
+    /// Return the item at zero-based position `index`, unchecked.
+    static constexpr RuntimeItem at(std::size_t index) {
+        return RuntimeItem{static_cast<std::uint32_t>(index)};
+    }
+
+    /// Return the zero-based position of `item`.
+    static constexpr std::size_t index(RuntimeItem item) {
+        return static_cast<std::size_t>(item);
+    }
+
+    /// Return `true` if `item` belongs to this enumeration.
+    bool contains(RuntimeItem item) const { return index(item) < size(); }
+
+    /// Return the name of `item`.
+    /// \throws std::out_of_range if `item` does not belong to this enumeration.
+    std::string_view name(RuntimeItem item) const {
+        const std::size_t i = index(item);
+        if (i >= size()) {
+            throw std::out_of_range("enumerate::RuntimeEnum::name");
+        }
+        return std::string_view{m_pool.data() + m_offsets[i], m_offsets[i + 1] - m_offsets[i]};
+    }
+
+    /// Return the item called `name`, if there is one.
+    std::optional<RuntimeItem> parse(std::string_view name) const {
+        const std::size_t mask = m_table.size() - 1;
+        std::size_t slot = detail::hash_name(name) & mask;
+        while (m_table[slot] != 0) {
+            const RuntimeItem item = at(m_table[slot] - 1);
+            if (this->name(item) == name) {
+                return item;
+            }
+            slot = (slot + 1) & mask;
+        }
+        return std::nullopt;
+    }
+
+    /// Hash all names in order; equal fingerprints mean equal enumerations.
+    std::uint64_t fingerprint() const {
+        std::uint64_t hash = detail::fnv1a_u64(detail::fnv_offset, size());
+        for (const RuntimeItem item : *this) {
+            const std::string_view n = name(item);
+            hash = detail::fnv1a(hash, n.data(), n.size());
+            hash = detail::fnv1a(hash, "", 1);
+        }
+        return hash;
+    }
+
+private:
+    /// Build the open-addressing table used by `parse()`.
+    void build_table() {
+        if (m_offsets.empty()) {
+            m_offsets.push_back(0);
+        }
+        m_table.assign(detail::ceil_pow2(2 * size() + 1), 0);
+        const std::size_t mask = m_table.size() - 1;
+        for (const RuntimeItem item : *this) {
+            std::size_t slot = detail::hash_name(name(item)) & mask;
+            while (m_table[slot] != 0) {
+                if (name(at(m_table[slot] - 1)) == name(item)) {
+                    throw std::invalid_argument("enumerate::RuntimeEnum: duplicate name");
+                }
+                slot = (slot + 1) & mask;
+            }
+            m_table[slot] = static_cast<std::uint32_t>(index(item) + 1);
+        }
+    }
+
+    /// All names, concatenated.
+    std::string m_pool;
+
+    /// Start of each name in `m_pool`, plus the total length.
+    std::vector<std::uint32_t> m_offsets;
+
+    /// Hash table of `index + 1`; zero marks an empty slot.
+    std::vector<std::uint32_t> m_table;
+};
+
+
+/**An array with one slot per item of a `RuntimeEnum`.
+ *
+ * The run-time counterpart of `EnumMap`: it is sized once, when it is
+ * created, and indexed by `RuntimeItem`.
+ */
+template<typename T>
+class RuntimeEnumMap {
+public:
+    using key_type = RuntimeItem;
+    using mapped_type = T;
+    using iterator = typename std::vector<T>::iterator;
+    using const_iterator = typename std::vector<T>::const_iterator;
+
+    /// Create a map with one copy of `value` per item of `domain`.
+    explicit RuntimeEnumMap(const RuntimeEnum& domain, const T& value = T{})
+        : m_data(domain.size(), value)
+    {}
+
+    /// Return the slot of `key`, unchecked.
+    T& operator [](RuntimeItem key) { return m_data[RuntimeEnum::index(key)]; }
+    const T& operator [](RuntimeItem key) const { return m_data[RuntimeEnum::index(key)]; }
+
+    /// Return the slot of `key`.
+    /// \throws std::out_of_range if `key` is not in the map's domain.
+    T& at(RuntimeItem key) { return m_data.at(RuntimeEnum::index(key)); }
+    const T& at(RuntimeItem key) const { return m_data.at(RuntimeEnum::index(key)); }
+
+    /// Return the number of slots.
+    std::size_t size() const { return m_data.size(); }
+
+    /// Return a pointer to the first slot.
+    T* data() { return m_data.data(); }
+    const T* data() const { return m_data.data(); }
+
+    /// Iterate over the values in key order.
+    iterator begin() { return m_data.begin(); }
+    iterator end() { return m_data.end(); }
+    const_iterator begin() const { return m_data.begin(); }
+    const_iterator end() const { return m_data.end(); }
+
+private:
+    /// One slot per item.
+    std::vector<T> m_data;
+};
+
+
+/**A set of items of a `RuntimeEnum`, stored as a bitset.
+ *
+ * The run-time counterpart of `EnumSet`.
+ */
+class RuntimeEnumSet {
+public:
+    using value_type = RuntimeItem;
+
+    /// Create an empty set over the items of `domain`.
+    explicit RuntimeEnumSet(const RuntimeEnum& domain)
+        : m_universe(domain.size()), m_words((domain.size() + 63) / 64, 0)
+    {}
+
+    /// Return `true` if `item` is in the set.
+    bool contains(RuntimeItem item) const {
+        const std::size_t i = RuntimeEnum::index(item);
+        return i < m_universe && ((m_words[i / 64] >> (i % 64)) & 1);
+    }
+
+    /// Add `item` to the set.
+    /// \throws std::out_of_range if `item` is not in the set's domain.
+    void insert(RuntimeItem item) {
+        const std::size_t i = checked_index(item);
+        m_words[i / 64] |= std::uint64_t{1} << (i % 64);
+    }
+
+    /// Remove `item` from the set.
+    /// \throws std::out_of_range if `item` is not in the set's domain.
+    void erase(RuntimeItem item) {
+        const std::size_t i = checked_index(item);
+        m_words[i / 64] &= ~(std::uint64_t{1} << (i % 64));
+    }
+
+    /// Return the number of items in the set.
+    std::size_t size() const {
+        std::size_t result = 0;
+        for (const std::uint64_t word : m_words) {
+            result += detail::popcount(word);
+        }
+        return result;
+    }
+
+    /// Return `true` if this set and `other` have at least one item in common.
+    bool intersects(const RuntimeEnumSet& other) const {
+        const std::size_t words = m_words.size() < other.m_words.size()
+            ? m_words.size() : other.m_words.size();
+        for (std::size_t i = 0; i < words; ++i) {
+            if ((m_words[i] & other.m_words[i]) != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// Call `f(item)` for every item in the set, in order.
+    template<typename F>
+    void for_each(F f) const {
+        for (std::size_t w = 0; w < m_words.size(); ++w) {
+            for (std::uint64_t word = m_words[w]; word != 0; word &= word - 1) {
+                f(RuntimeEnum::at(w * 64 + detail::count_trailing_zeros(word)));
+            }
+        }
+    }
+
+private:
+    std::size_t checked_index(RuntimeItem item) const {
+        const std::size_t i = RuntimeEnum::index(item);
+        if (i >= m_universe) {
+            throw std::out_of_range("enumerate::RuntimeEnumSet");
+        }
+        return i;
+    }
+
+    /// Number of items in the domain.
+    std::size_t m_universe;
+
+    /// Bit `i % 64` of word `i / 64` is set if item `i` is in the set.
+    std::vector<std::uint64_t> m_words;
+};
+
+}
+
+#endif // ENUMERATE_RUNTIME_ENUM_HPP
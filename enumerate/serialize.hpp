@@ -0,0 +1,604 @@
+/*
+ * enumerate/serialize.hpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Nico Madysa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENUMERATE_SERIALIZE_HPP
+#define ENUMERATE_SERIALIZE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#if __has_include(<sys/mman.h>)
+#include <cerrno>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ENUMERATE_HAVE_MMAP 1
+#endif
+
+#include "../enumerate.hpp"
+#include "containers.hpp"
+#include "names.hpp"
+
+
+namespace enumerate {
+
+/// Thrown when a buffer does not hold a container that can be loaded.
+class SerializationError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+
+/// The kinds of container that can be serialized.
+enum class ContainerKind : std::uint8_t {
+    Map = 1,
+    Set = 2,
+    Column = 3,
+};
+
+
+/**The fixed-size header at the start of every serialized container.
+ *
+ * All fields are stored in native byte order. A buffer written on a
+ * machine of different byte order is recognized by its magic number
+ * and rejected. The header is followed by the name table, if the
+ * `enum` had registered names when the buffer was written, and then by
+ * the payload. Both start at multiples of `SerializedHeader::alignment`
+ * so that a memory-mapped payload can be used in place.
+ */
+struct SerializedHeader {
+    /// The bytes "ENUM" as read by a little-endian machine.
+    static constexpr std::uint32_t magic_value = 0x4d554e45;
+
+    /// The current version of the format.
+    static constexpr std::uint16_t current_version = 1;
+
+    /// Alignment of the name table and the payload in bytes.
+    static constexpr std::size_t alignment = 64;
+
+    std::uint32_t magic;
+    std::uint16_t version;
+    /// A `ContainerKind`.
+    std::uint8_t kind;
+    /// `sizeof` the underlying type of the `enum`.
+    std::uint8_t key_width;
+    /// Non-zero if the underlying type of the `enum` is signed.
+    std::uint8_t key_signed;
+    std::uint8_t reserved[7];
+    /// `fingerprint()` of the `enum` that wrote the buffer.
+    std::uint64_t fingerprint;
+    /// Underlying value of `BEGIN` when the buffer was written.
+    std::int64_t begin_value;
+    /// Number of items between `BEGIN` and `END`.
+    std::uint64_t key_count;
+    /// Size of one element of the payload in bytes.
+    std::uint64_t element_size;
+    /// Number of elements in the payload.
+    std::uint64_t element_count;
+    /// Offset of the name table from the start of the buffer, or zero.
+    std::uint64_t names_offset;
+    /// Offset of the payload from the start of the buffer.
+    std::uint64_t payload_offset;
+};
+
+
+/**A read-only view of a column of `enum` items inside a buffer.
+ *
+ * This is what a column loads as when its layout still matches the
+ * program's: the items are used in place, nothing is copied.
+ */
+template<typename Enum>
+class ColumnView {
+public:
+    using value_type = Enum;
+    using const_iterator = const Enum*;
+
+    constexpr ColumnView() = default;
+    constexpr ColumnView(const Enum* data, std::size_t size) noexcept
+        : m_data(data), m_size(size)
+    {}
+
+    constexpr const Enum* data() const { return m_data; }
+    constexpr std::size_t size() const { return m_size; }
+    constexpr bool empty() const { return m_size == 0; }
+    constexpr const Enum& operator [](std::size_t i) const { return m_data[i]; }
+    constexpr const_iterator begin() const { return m_data; }
+    constexpr const_iterator end() const { return m_data + m_size; }
+
+private:
+    const Enum* m_data = nullptr;
+    std::size_t m_size = 0;
+};
+
+
+namespace detail {
+
+/// Round `offset` up to the next multiple of the header alignment.
+constexpr std::uint64_t align_offset(std::uint64_t offset) {
+    constexpr std::uint64_t a = SerializedHeader::alignment;
+    return (offset + a - 1) / a * a;
+}
+
+/// Build the header describing a container of `Enum`.
+template<typename Enum>
+SerializedHeader make_header(
+    ContainerKind kind, std::size_t element_size, std::size_t element_count
+) {
+    using integral_type = typename Enumerate<Enum>::integral_type;
+    SerializedHeader header{};
+    header.magic = SerializedHeader::magic_value;
+    header.version = SerializedHeader::current_version;
+    header.kind = static_cast<std::uint8_t>(kind);
+    header.key_width = sizeof(integral_type);
+    header.key_signed = std::is_signed<integral_type>::value;
+    header.fingerprint = fingerprint<Enum>();
+    header.begin_value = static_cast<std::int64_t>(
+        static_cast<integral_type>(Enumerate<Enum>::begin_value));
+    header.key_count = Enumerate<Enum>::size();
+    header.element_size = element_size;
+    header.element_count = element_count;
+    std::uint64_t offset = align_offset(sizeof(SerializedHeader));
+    if constexpr (has_names<Enum>::value) {
+        header.names_offset = offset;
+        offset += (header.key_count + 1) * sizeof(std::uint32_t);
+        offset += NamePool<Enum>::pool_size;
+        offset = align_offset(offset);
+    }
+    header.payload_offset = offset;
+    return header;
+}
+
+/// Write `size` zero bytes.
+inline void write_padding(std::ostream& os, std::uint64_t size) {
+    static const char zeros[SerializedHeader::alignment] = {};
+    os.write(zeros, static_cast<std::streamsize>(size));
+}
+
+/// Write header, name table and payload of a container of `Enum`.
+template<typename Enum>
+void write_container(
+    std::ostream& os, ContainerKind kind,
+    std::size_t element_size, std::size_t element_count, const void* payload
+) {
+    const SerializedHeader header =
+        make_header<Enum>(kind, element_size, element_count);
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    std::uint64_t pos = sizeof(header);
+    if constexpr (has_names<Enum>::value) {
+        using pool = NamePool<Enum>;
+        write_padding(os, header.names_offset - pos);
+        os.write(reinterpret_cast<const char*>(pool::offsets()),
+                 (pool::count + 1) * sizeof(std::uint32_t));
+        os.write(pool::data(), pool::pool_size);
+        pos = header.names_offset
+            + (pool::count + 1) * sizeof(std::uint32_t) + pool::pool_size;
+    }
+    write_padding(os, header.payload_offset - pos);
+    os.write(static_cast<const char*>(payload),
+             static_cast<std::streamsize>(element_size * element_count));
+    if (!os) {
+        throw SerializationError("enumerate: could not write container");
+    }
+}
+
+/// Read and validate the header of a buffer that should hold a `kind`.
+inline SerializedHeader read_header(
+    const void* data, std::size_t size, ContainerKind kind
+) {
+    SerializedHeader header;
+    if (size < sizeof(header)) {
+        throw SerializationError("enumerate: buffer too small for header");
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != SerializedHeader::magic_value) {
+        throw SerializationError(
+            "enumerate: bad magic number or foreign byte order");
+    }
+    if (header.version != SerializedHeader::current_version) {
+        throw SerializationError("enumerate: unsupported format version");
+    }
+    if (header.kind != static_cast<std::uint8_t>(kind)) {
+        throw SerializationError("enumerate: buffer holds another container");
+    }
+    if (header.element_size == 0 && header.element_count != 0) {
+        throw SerializationError("enumerate: elements have zero size");
+    }
+    const std::uint64_t max = std::numeric_limits<std::uint64_t>::max();
+    if (header.element_size != 0
+        && header.element_count > max / header.element_size) {
+        throw SerializationError("enumerate: payload size overflows");
+    }
+    if (header.payload_offset > size
+        || header.element_size * header.element_count
+           > size - header.payload_offset) {
+        throw SerializationError("enumerate: buffer truncated");
+    }
+    return header;
+}
+
+/// Return `true` if `header` describes the layout of `Enum` exactly.
+template<typename Enum>
+bool same_layout(const SerializedHeader& header) {
+    using integral_type = typename Enumerate<Enum>::integral_type;
+    return header.fingerprint == fingerprint<Enum>()
+        && header.key_width == sizeof(integral_type)
+        && (header.key_signed != 0) == std::is_signed<integral_type>::value
+        && header.key_count == Enumerate<Enum>::size();
+}
+
+/// Read one stored key of `width` bytes and convert it to a wide integer.
+inline std::int64_t read_key(const unsigned char* p, std::uint8_t width, bool is_signed) {
+    switch (width) {
+    case 1: {
+        std::uint8_t v; std::memcpy(&v, p, 1);
+        return is_signed ? static_cast<std::int8_t>(v) : v;
+    }
+    case 2: {
+        std::uint16_t v; std::memcpy(&v, p, 2);
+        return is_signed ? static_cast<std::int16_t>(v) : v;
+    }
+    case 4: {
+        std::uint32_t v; std::memcpy(&v, p, 4);
+        return is_signed ? static_cast<std::int32_t>(v) : static_cast<std::int64_t>(v);
+    }
+    case 8: {
+        std::int64_t v; std::memcpy(&v, p, 8);
+        return v;
+    }
+    default:
+        throw SerializationError("enumerate: unsupported key width");
+    }
+}
+
+}
+
+
+/**Translation from the positions of a stored `enum` to the current one.
+ *
+ * When a buffer was written by a build with a different `enum` layout,
+ * items are matched up by name. The table is computed once per load
+ * and then applied to every element, so the name lookups are paid per
+ * key rather than per element.
+ */
+template<typename Enum>
+class RemapTable {
+public:
+    /// Marks a stored item that no longer exists.
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    /**Build the table from a buffer whose header has been validated.
+     *
+     * \throws SerializationError if either side has no registered names.
+     */
+    RemapTable(const void* data, std::size_t size, const SerializedHeader& header) {
+        if constexpr (!has_names<Enum>::value) {
+            throw SerializationError(
+                "enumerate: enum layout changed and it has no names to remap by");
+        } else {
+            if (header.names_offset == 0) {
+                throw SerializationError(
+                    "enumerate: enum layout changed and the buffer has no names");
+            }
+            const auto* base = static_cast<const unsigned char*>(data);
+            // Bound key_count first so that the table size cannot wrap.
+            if (header.names_offset > size
+                || header.key_count
+                   >= (size - header.names_offset) / sizeof(std::uint32_t)) {
+                throw SerializationError("enumerate: name table truncated");
+            }
+            const std::uint64_t table_size = (header.key_count + 1) * sizeof(std::uint32_t);
+            std::vector<std::uint32_t> offsets(header.key_count + 1);
+            std::memcpy(offsets.data(), base + header.names_offset, table_size);
+            const char* chars = reinterpret_cast<const char*>(
+                base + header.names_offset + table_size);
+            const std::uint64_t chars_size = size - header.names_offset - table_size;
+            m_new_index.resize(header.key_count, npos);
+            for (std::size_t old_index = 0; old_index < header.key_count; ++old_index) {
+                const std::uint32_t first = offsets[old_index];
+                const std::uint32_t last = offsets[old_index + 1];
+                if (first > last || last > chars_size) {
+                    throw SerializationError("enumerate: name table corrupt");
+                }
+                const std::size_t found = NamePool<Enum>::find(
+                    std::string_view{chars + first, last - first});
+                if (found != NamePool<Enum>::count) {
+                    m_new_index[old_index] = found;
+                }
+            }
+        }
+    }
+
+    /// Return the current position of the stored item `old_index`, or `npos`.
+    std::size_t operator [](std::size_t old_index) const {
+        return old_index < m_new_index.size() ? m_new_index[old_index] : npos;
+    }
+
+    /// Return the number of stored items.
+    std::size_t size() const { return m_new_index.size(); }
+
+private:
+    /// Current position of every stored item.
+    std::vector<std::size_t> m_new_index;
+};
+
+
+/// Write `map` to `os`; the values must be trivially copyable.
+template<typename Enum, typename T>
+void save(std::ostream& os, const EnumMap<Enum, T>& map) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "only maps of trivially copyable values can be saved");
+    detail::write_container<Enum>(
+        os, ContainerKind::Map, sizeof(T), map.size(), map.data());
+}
+
+
+/// Write `set` to `os`.
+template<typename Enum>
+void save(std::ostream& os, const EnumSet<Enum>& set) {
+    using set_type = EnumSet<Enum>;
+    detail::write_container<Enum>(
+        os, ContainerKind::Set, sizeof(typename set_type::word_type),
+        set_type::word_count, set.words());
+}
+
+
+/// Write the `size` items starting at `data` to `os`.
+template<typename Enum>
+void save_column(std::ostream& os, const Enum* data, std::size_t size) {
+    detail::write_container<Enum>(
+        os, ContainerKind::Column, sizeof(Enum), size, data);
+}
+
+
+/**Load a map that has been written by `save()`.
+ *
+ * If the stored layout matches `Enum`, the values are copied in one
+ * go. Otherwise, keys are matched up by name; keys that no longer
+ * exist are dropped and new keys are value-initialized.
+ *
+ * \throws SerializationError if the buffer is invalid or the layout
+ *         changed and cannot be remapped.
+ */
+template<typename Enum, typename T>
+EnumMap<Enum, T> load_map(const void* data, std::size_t size) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "only maps of trivially copyable values can be loaded");
+    const auto header = detail::read_header(data, size, ContainerKind::Map);
+    if (header.element_size != sizeof(T) || header.element_count != header.key_count) {
+        throw SerializationError("enumerate: map value type differs");
+    }
+    const auto* payload = static_cast<const unsigned char*>(data) + header.payload_offset;
+    EnumMap<Enum, T> result;
+    if (detail::same_layout<Enum>(header)) {
+        std::memcpy(result.data(), payload, sizeof(T) * result.size());
+        return result;
+    }
+    const RemapTable<Enum> remap{data, size, header};
+    for (std::size_t old_index = 0; old_index < remap.size(); ++old_index) {
+        const std::size_t new_index = remap[old_index];
+        if (new_index != RemapTable<Enum>::npos) {
+            std::memcpy(result.data() + new_index, payload + old_index * sizeof(T), sizeof(T));
+        }
+    }
+    return result;
+}
+
+
+/**Load a set that has been written by `save()`.
+ *
+ * Items that no longer exist are dropped.
+ *
+ * \throws SerializationError if the buffer is invalid or the layout
+ *         changed and cannot be remapped.
+ */
+template<typename Enum>
+EnumSet<Enum> load_set(const void* data, std::size_t size) {
+    using set_type = EnumSet<Enum>;
+    using word_type = typename set_type::word_type;
+    const auto header = detail::read_header(data, size, ContainerKind::Set);
+    if (header.element_size != sizeof(word_type)
+        || header.element_count != (header.key_count + 63) / 64) {
+        throw SerializationError("enumerate: set word size differs");
+    }
+    const auto* payload = static_cast<const unsigned char*>(data) + header.payload_offset;
+    set_type result;
+    if (detail::same_layout<Enum>(header)) {
+        std::memcpy(result.words(), payload, sizeof(word_type) * set_type::word_count);
+        return result;
+    }
+    const RemapTable<Enum> remap{data, size, header};
+    for (std::size_t w = 0; w < header.element_count; ++w) {
+        word_type word;
+        std::memcpy(&word, payload + w * sizeof(word_type), sizeof(word_type));
+        for (; word != 0; word &= word - 1) {
+            const std::size_t old_index = w * 64 + detail::count_trailing_zeros(word);
+            const std::size_t new_index = remap[old_index];
+            if (new_index != RemapTable<Enum>::npos) {
+                result.insert(from_index<Enum>(new_index));
+            }
+        }
+    }
+    return result;
+}
+
+
+/**Return a zero-copy view of a column that has been written by `save_column()`.
+ *
+ * \throws SerializationError if the buffer is invalid, the stored
+ *         layout differs from `Enum` or the payload is misaligned. Use
+ *         `load_column()` to fall back to a remapping copy.
+ */
+template<typename Enum>
+ColumnView<Enum> view_column(const void* data, std::size_t size) {
+    const auto header = detail::read_header(data, size, ContainerKind::Column);
+    if (!detail::same_layout<Enum>(header) || header.element_size != sizeof(Enum)) {
+        throw SerializationError("enumerate: column layout differs");
+    }
+    const auto* payload = static_cast<const unsigned char*>(data) + header.payload_offset;
+    if (reinterpret_cast<std::uintptr_t>(payload) % alignof(Enum) != 0) {
+        throw SerializationError("enumerate: column payload misaligned");
+    }
+    return ColumnView<Enum>{reinterpret_cast<const Enum*>(payload),
+                            static_cast<std::size_t>(header.element_count)};
+}
+
+
+/**Load a copy of a column that has been written by `save_column()`.
+ *
+ * If the stored layout matches `Enum`, the items are copied in one go.
+ * Otherwise, every item is translated through a `RemapTable`.
+ *
+ * \throws SerializationError if the buffer is invalid, or if the layout
+ *         changed and the column contains an item that no longer exists.
+ */
+template<typename Enum>
+std::vector<Enum> load_column(const void* data, std::size_t size) {
+    const auto header = detail::read_header(data, size, ContainerKind::Column);
+    const auto* payload = static_cast<const unsigned char*>(data) + header.payload_offset;
+    const bool same = detail::same_layout<Enum>(header) && header.element_size == sizeof(Enum);
+    // Check the element size before allocating, so that element_count is
+    // known to be bounded by the buffer size.
+    if (!same && header.element_size != header.key_width) {
+        throw SerializationError("enumerate: column element size differs");
+    }
+    std::vector<Enum> result(static_cast<std::size_t>(header.element_count));
+    if (same) {
+        std::memcpy(result.data(), payload, sizeof(Enum) * result.size());
+        return result;
+    }
+    const RemapTable<Enum> remap{data, size, header};
+    // Precompute the translated item for every stored position.
+    std::vector<Enum> translated(remap.size());
+    std::vector<bool> valid(remap.size());
+    for (std::size_t old_index = 0; old_index < remap.size(); ++old_index) {
+        valid[old_index] = remap[old_index] != RemapTable<Enum>::npos;
+        if (valid[old_index]) {
+            translated[old_index] = from_index<Enum>(remap[old_index]);
+        }
+    }
+    for (std::size_t i = 0; i < result.size(); ++i) {
+        const std::int64_t key = detail::read_key(
+            payload + i * header.key_width, header.key_width, header.key_signed != 0);
+        const std::uint64_t old_index =
+            static_cast<std::uint64_t>(key) - static_cast<std::uint64_t>(header.begin_value);
+        if (old_index >= remap.size() || !valid[old_index]) {
+            throw SerializationError("enumerate: column holds an item that no longer exists");
+        }
+        result[i] = translated[old_index];
+    }
+    return result;
+}
+
+
+#ifdef ENUMERATE_HAVE_MMAP
+/**A file mapped read-only into memory.
+ *
+ * Pass `data()` and `size()` to the `load_*()` and `view_column()`
+ * functions to load containers straight from the page cache. Views
+ * into the mapping stay valid for as long as the `MappedFile` lives.
+ */
+class MappedFile {
+public:
+    /// Map the file at `path`.
+    /// \throws std::system_error if the file cannot be opened or mapped.
+    explicit MappedFile(const char* path) {
+        const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), path);
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            const int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), path);
+        }
+        m_size = static_cast<std::size_t>(info.st_size);
+        if (m_size != 0) {
+            m_data = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (m_data == MAP_FAILED) {
+                const int error = errno;
+                ::close(fd);
+                throw std::system_error(error, std::generic_category(), path);
+            }
+        }
+        ::close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator =(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept
+        : m_data(other.m_data), m_size(other.m_size)
+    {
+        other.m_data = nullptr;
+        other.m_size = 0;
+    }
+
+    MappedFile& operator =(MappedFile&& other) noexcept {
+        if (this != &other) {
+            unmap();
+            m_data = other.m_data;
+            m_size = other.m_size;
+            other.m_data = nullptr;
+            other.m_size = 0;
+        }
+        return *this;
+    }
+
+    ~MappedFile() { unmap(); }
+
+    /// Return the start of the mapping.
+    const void* data() const { return m_data; }
+
+    /// Return the size of the mapping in bytes.
+    std::size_t size() const { return m_size; }
+
+private:
+    void unmap() {
+        if (m_data != nullptr) {
+            ::munmap(m_data, m_size);
+        }
+    }
+
+    void* m_data = nullptr;
+    std::size_t m_size = 0;
+};
+#endif
+
+}
+
+#endif // ENUMERATE_SERIALIZE_HPP
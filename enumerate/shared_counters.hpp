@@ -0,0 +1,320 @@
+/*
+ * enumerate/shared_counters.hpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Nico Madysa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENUMERATE_SHARED_COUNTERS_HPP
+#define ENUMERATE_SHARED_COUNTERS_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../enumerate.hpp"
+#include "containers.hpp"
+#include "names.hpp"
+#include "serialize.hpp"
+
+
+namespace enumerate {
+
+/**A table of atomic per-item counters in a named POSIX shared-memory segment.
+ *
+ * Any number of processes can map the same segment and increment or
+ * read the counters without locks. The segment starts with a header
+ * that records the `enum`'s `fingerprint()`, so a process that was
+ * built against a different layout of the `enum` refuses to attach
+ * rather than misinterpreting the counters.
+ *
+ * ```
+ * auto table = SharedCounters<Request>::open_or_create("/requests");
+ * table.add(Request::Get);
+ * ```
+ */
+template<typename Enum>
+class SharedCounters {
+public:
+    /// The type of a single counter.
+    using counter_type = std::atomic<std::uint64_t>;
+
+    static_assert(counter_type::is_always_lock_free,
+                  "shared counters require lock-free 64-bit atomics");
+
+    /// Number of counters, i.e. the number of items in `Enum`.
+    static constexpr std::size_t count = Enumerate<Enum>::size();
+
+private:
+    /// The header at the start of the segment.
+    struct Header {
+        /// The bytes "ENCT" as read by a little-endian machine.
+        static constexpr std::uint32_t magic_value = 0x54434e45;
+        static constexpr std::uint32_t current_version = 1;
+
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint64_t fingerprint;
+        std::uint64_t count;
+        /// Set last by the creator, once the counters are initialized.
+        std::atomic<std::uint32_t> ready;
+    };
+
+    /// Offset of the counters from the start of the segment.
+    static constexpr std::size_t counters_offset = 64;
+
+    static_assert(sizeof(Header) <= counters_offset, "header too large");
+
+    /// Total size of the segment in bytes.
+    static constexpr std::size_t segment_size =
+        counters_offset + count * sizeof(counter_type);
+
+public:
+    /**Create a new segment called `name` with all counters at zero.
+     *
+     * \throws std::system_error if the segment exists or cannot be created.
+     */
+    static SharedCounters create(const char* name) {
+        const int fd = ::shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), name);
+        }
+        if (::ftruncate(fd, segment_size) != 0) {
+            const int error = errno;
+            ::close(fd);
+            ::shm_unlink(name);
+            throw std::system_error(error, std::generic_category(), name);
+        }
+        // Do not leave behind a segment that nobody initializes.
+        SharedCounters result = [&] {
+            try {
+                return SharedCounters{fd, name};
+            } catch (...) {
+                ::shm_unlink(name);
+                throw;
+            }
+        }();
+        auto* header = ::new (result.m_base) Header{};
+        header->magic = Header::magic_value;
+        header->version = Header::current_version;
+        header->fingerprint = fingerprint<Enum>();
+        header->count = count;
+        for (std::size_t i = 0; i < count; ++i) {
+            ::new (result.m_counters + i) counter_type{0};
+        }
+        header->ready.store(1, std::memory_order_release);
+        return result;
+    }
+
+    /**Attach to the existing segment called `name`.
+     *
+     * \throws std::system_error if the segment cannot be opened.
+     * \throws SerializationError if the segment has not been initialized
+     *         yet or was created for a different `enum` layout.
+     */
+    static SharedCounters open(const char* name) {
+        const int fd = ::shm_open(name, O_RDWR | O_CLOEXEC, 0);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), name);
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            const int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), name);
+        }
+        if (static_cast<std::size_t>(info.st_size) != segment_size) {
+            ::close(fd);
+            throw SerializationError("enumerate: shared counters have a different size");
+        }
+        SharedCounters result{fd, name};
+        const Header& header = result.header();
+        if (header.ready.load(std::memory_order_acquire) == 0) {
+            throw SerializationError("enumerate: shared counters not initialized yet");
+        }
+        if (header.magic != Header::magic_value
+            || header.version != Header::current_version
+            || header.fingerprint != fingerprint<Enum>()
+            || header.count != count) {
+            throw SerializationError("enumerate: shared counters of another enum layout");
+        }
+        return result;
+    }
+
+    /**Attach to the segment called `name`, creating it if necessary.
+     *
+     * If another process creates the segment concurrently, this retries
+     * for a while until that process has finished initializing it.
+     */
+    static SharedCounters open_or_create(const char* name) {
+        constexpr int max_attempts = 10000;
+        for (int attempt = 1; ; ++attempt) {
+            try {
+                return create(name);
+            } catch (const std::system_error& error) {
+                if (error.code() != std::errc::file_exists) {
+                    throw;
+                }
+            }
+            try {
+                return open(name);
+            } catch (const SerializationError&) {
+                // Tolerate a segment whose creator is still initializing it.
+                if (attempt == max_attempts || is_initialized(name)) {
+                    throw;
+                }
+                std::this_thread::yield();
+            } catch (const std::system_error& error) {
+                // The segment may have been removed in the meantime.
+                if (error.code() != std::errc::no_such_file_or_directory) {
+                    throw;
+                }
+            }
+        }
+    }
+
+    /// Remove the segment called `name`; existing mappings stay valid.
+    static void remove(const char* name) {
+        ::shm_unlink(name);
+    }
+
+    SharedCounters(const SharedCounters&) = delete;
+    SharedCounters& operator =(const SharedCounters&) = delete;
+
+    SharedCounters(SharedCounters&& other) noexcept
+        : m_base(other.m_base), m_counters(other.m_counters), m_name(std::move(other.m_name))
+    {
+        other.m_base = nullptr;
+        other.m_counters = nullptr;
+    }
+
+    SharedCounters& operator =(SharedCounters&& other) noexcept {
+        if (this != &other) {
+            unmap();
+            m_base = other.m_base;
+            m_counters = other.m_counters;
+            m_name = std::move(other.m_name);
+            other.m_base = nullptr;
+            other.m_counters = nullptr;
+        }
+        return *this;
+    }
+
+    ~SharedCounters() { unmap(); }
+
+    /// Add `amount` to the counter of `item`.
+    void add(Enum item, std::uint64_t amount = 1) {
+        m_counters[to_index(item)].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    /// Return the current value of the counter of `item`.
+    std::uint64_t load(Enum item) const {
+        return m_counters[to_index(item)].load(std::memory_order_relaxed);
+    }
+
+    /// Return the counter of `item` for direct atomic access.
+    counter_type& operator [](Enum item) { return m_counters[to_index(item)]; }
+
+    /// Return the values of all counters.
+    /// Each counter is read atomically, but not all of them at once.
+    EnumMap<Enum, std::uint64_t> snapshot() const {
+        EnumMap<Enum, std::uint64_t> result;
+        for (std::size_t i = 0; i < count; ++i) {
+            result.data()[i] = m_counters[i].load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    /// Return the name of the segment.
+    const std::string& name() const { return m_name; }
+
+private:
+    /// Map the segment behind `fd` and close `fd`.
+    SharedCounters(int fd, const char* name)
+        : m_name(name)
+    {
+        void* base = ::mmap(nullptr, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        const int error = errno;
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            throw std::system_error(error, std::generic_category(), name);
+        }
+        m_base = static_cast<unsigned char*>(base);
+        m_counters = reinterpret_cast<counter_type*>(m_base + counters_offset);
+    }
+
+    /// Return `true` if the segment `name` exists and has been initialized.
+    static bool is_initialized(const char* name) {
+        const int fd = ::shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        bool result = false;
+        if (::fstat(fd, &info) == 0 && static_cast<std::size_t>(info.st_size) >= sizeof(Header)) {
+            void* base = ::mmap(nullptr, sizeof(Header), PROT_READ, MAP_SHARED, fd, 0);
+            if (base != MAP_FAILED) {
+                const auto* header = static_cast<const Header*>(base);
+                result = header->ready.load(std::memory_order_acquire) != 0;
+                ::munmap(base, sizeof(Header));
+            }
+        }
+        ::close(fd);
+        return result;
+    }
+
+    const Header& header() const {
+        return *reinterpret_cast<const Header*>(m_base);
+    }
+
+    void unmap() {
+        if (m_base != nullptr) {
+            ::munmap(m_base, segment_size);
+        }
+    }
+
+    /// Start of the mapping.
+    unsigned char* m_base = nullptr;
+
+    /// The counters, `counters_offset` bytes into the mapping.
+    counter_type* m_counters = nullptr;
+
+    /// Name of the segment.
+    std::string m_name;
+};
+
+}
+
+#endif // ENUMERATE_SHARED_COUNTERS_HPP
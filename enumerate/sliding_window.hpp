@@ -0,0 +1,231 @@
+/*
+ * enumerate/sliding_window.hpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Nico Madysa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENUMERATE_SLIDING_WINDOW_HPP
+#define ENUMERATE_SLIDING_WINDOW_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+#include "../enumerate.hpp"
+#include "containers.hpp"
+
+
+namespace enumerate {
+
+/**Event counts per `enum` item over a sliding window of time.
+ *
+ * Time is divided into buckets of a fixed width, and the window covers
+ * the last `Buckets` of them, including the current, partial one. All
+ * counters live in one allocation laid out as `[bucket][item]`, so
+ * aggregating the window for every item reads contiguous memory.
+ *
+ * Each cell packs the bucket's epoch into its high `tag_bits` bits and
+ * the count into the remaining bits. Recording compares the tag with
+ * the current epoch: a matching cell is incremented, any other one is
+ * reset to the new epoch in the same compare-and-swap. Thus there is
+ * no lock and no background thread that rotates buckets. The latest
+ * epoch any writer has seen is kept as well; an event is only dropped
+ * if its bucket has already left the window relative to that epoch,
+ * because only then can its cell belong to a newer bucket. Counts
+ * saturate at `2^count_bits - 1` per bucket.
+ *
+ * Queries skip cells whose tag is outside of the window, and read all
+ * `Buckets` buckets of an item, so they take time proportional to
+ * `Buckets`. Tags wrap around after `2^tag_bits` buckets, e.g. after
+ * 49 days with buckets of a millisecond; a cell that has not been
+ * touched for exactly a multiple of that period is mistaken for a
+ * current one.
+ *
+ * ```
+ * SlidingWindowCounters<Endpoint> requests{std::chrono::seconds{1}};
+ * requests.add(Endpoint::Login);
+ * const double qps = requests.rate(Endpoint::Login);
+ * ```
+ */
+template<typename Enum, std::size_t Buckets = 60,
+         typename Clock = std::chrono::steady_clock>
+class SlidingWindowCounters {
+    static_assert(Buckets > 0, "the window needs at least one bucket");
+
+public:
+    /// Number of counters per bucket, i.e. the number of items in `Enum`.
+    static constexpr std::size_t count = Enumerate<Enum>::size();
+
+    /// Number of bits per cell that hold the bucket's epoch.
+    static constexpr unsigned tag_bits = 32;
+
+    /// Number of bits per cell that hold the count.
+    static constexpr unsigned count_bits = 64 - tag_bits;
+
+    static_assert(Buckets < (std::uint64_t{1} << tag_bits),
+                  "the window must be shorter than the tag period");
+
+    /// The clock's time points.
+    using time_point = typename Clock::time_point;
+
+    /**Create a window of `Buckets` buckets of `bucket_width` each.
+     *
+     * \throws std::invalid_argument if `bucket_width` is not positive.
+     */
+    explicit SlidingWindowCounters(typename Clock::duration bucket_width)
+        : m_bucket_width(bucket_width),
+          m_cells(new std::atomic<std::uint64_t>[Buckets * count]())
+    {
+        if (bucket_width.count() <= 0) {
+            throw std::invalid_argument("enumerate: bucket width must be positive");
+        }
+    }
+
+    /// Return the width of a single bucket.
+    typename Clock::duration bucket_width() const { return m_bucket_width; }
+
+    /// Return the length of the window.
+    typename Clock::duration window() const { return m_bucket_width * Buckets; }
+
+    /// Add `amount` to the count of `item` at time `now`.
+    void add(Enum item, std::uint64_t amount = 1, time_point now = Clock::now()) {
+        const std::uint64_t epoch = epoch_of(now);
+        advance_latest(epoch);
+        std::atomic<std::uint64_t>& cell = m_cells[(epoch % Buckets) * count + to_index(item)];
+        const std::uint64_t tag = epoch & tag_mask;
+        std::uint64_t old = cell.load(std::memory_order_acquire);
+        std::uint64_t desired;
+        do {
+            if ((old >> count_bits) == tag) {
+                const std::uint64_t value = old & count_mask;
+                desired = (tag << count_bits)
+                        | (amount < count_mask - value ? value + amount : count_mask);
+            } else if (epoch + Buckets <= m_latest.load(std::memory_order_acquire)) {
+                // A late writer; the bucket has left the window, and
+                // its cell may already belong to a newer bucket.
+                return;
+            } else {
+                desired = (tag << count_bits) | (amount < count_mask ? amount : count_mask);
+            }
+        } while (!cell.compare_exchange_weak(old, desired, std::memory_order_acq_rel,
+                                             std::memory_order_acquire));
+    }
+
+    /// Return the number of events of `item` within the window ending at `now`.
+    std::uint64_t total(Enum item, time_point now = Clock::now()) const {
+        const std::uint64_t epoch = epoch_of(now);
+        std::uint64_t result = 0;
+        for (std::size_t age = 0; age < Buckets && age <= epoch; ++age) {
+            result += value_of(cell(epoch - age, to_index(item)), epoch - age);
+        }
+        return result;
+    }
+
+    /**Return the events of `item` per second within the window ending at `now`.
+     *
+     * The rate is taken over the time the window actually covers: the
+     * elapsed part of the current bucket plus the full buckets before it.
+     */
+    double rate(Enum item, time_point now = Clock::now()) const {
+        const double seconds = covered_seconds(now);
+        return seconds > 0 ? total(item, now) / seconds : 0.0;
+    }
+
+    /// Return the number of events of every item within the window ending at `now`.
+    EnumMap<Enum, std::uint64_t> snapshot(time_point now = Clock::now()) const {
+        const std::uint64_t epoch = epoch_of(now);
+        EnumMap<Enum, std::uint64_t> result;
+        for (std::size_t age = 0; age < Buckets && age <= epoch; ++age) {
+            for (std::size_t i = 0; i < count; ++i) {
+                result.data()[i] += value_of(cell(epoch - age, i), epoch - age);
+            }
+        }
+        return result;
+    }
+
+    /// Return the events per second of every item within the window ending at `now`.
+    EnumMap<Enum, double> rates(time_point now = Clock::now()) const {
+        const auto totals = snapshot(now);
+        const double seconds = covered_seconds(now);
+        EnumMap<Enum, double> result;
+        for (std::size_t i = 0; i < count; ++i) {
+            result.data()[i] = seconds > 0 ? totals.data()[i] / seconds : 0.0;
+        }
+        return result;
+    }
+
+private:
+    static constexpr std::uint64_t tag_mask = (std::uint64_t{1} << tag_bits) - 1;
+    static constexpr std::uint64_t count_mask = (std::uint64_t{1} << count_bits) - 1;
+
+    /// Return the number of the bucket that contains `time`.
+    std::uint64_t epoch_of(time_point time) const {
+        return static_cast<std::uint64_t>(time.time_since_epoch() / m_bucket_width);
+    }
+
+    /// Return the cell of the item at position `index` in bucket `epoch`.
+    const std::atomic<std::uint64_t>& cell(std::uint64_t epoch, std::size_t index) const {
+        return m_cells[(epoch % Buckets) * count + index];
+    }
+
+    /// Return the count in `cell` if it belongs to `epoch`, zero otherwise.
+    static std::uint64_t value_of(const std::atomic<std::uint64_t>& cell, std::uint64_t epoch) {
+        const std::uint64_t value = cell.load(std::memory_order_relaxed);
+        return (value >> count_bits) == (epoch & tag_mask) ? value & count_mask : 0;
+    }
+
+    /// Raise `m_latest` to `epoch` unless it is already later.
+    void advance_latest(std::uint64_t epoch) {
+        std::uint64_t latest = m_latest.load(std::memory_order_relaxed);
+        while (latest < epoch
+               && !m_latest.compare_exchange_weak(latest, epoch, std::memory_order_acq_rel)) {
+        }
+    }
+
+    /// Return the seconds covered by the window ending at `now`.
+    double covered_seconds(time_point now) const {
+        const std::uint64_t epoch = epoch_of(now);
+        using rep = typename Clock::rep;
+        const std::uint64_t full = epoch < Buckets - 1 ? epoch : Buckets - 1;
+        const auto partial = now.time_since_epoch() - m_bucket_width * static_cast<rep>(epoch);
+        return std::chrono::duration<double>(
+            m_bucket_width * static_cast<rep>(full) + partial).count();
+    }
+
+    typename Clock::duration m_bucket_width;
+
+    /// The latest epoch passed to `add()`.
+    std::atomic<std::uint64_t> m_latest{0};
+
+    /// `Buckets` rows of one cell per item.
+    std::unique_ptr<std::atomic<std::uint64_t>[]> m_cells;
+};
+
+}
+
+#endif // ENUMERATE_SLIDING_WINDOW_HPP
@@ -0,0 +1,426 @@
+/*
+ * enumerate/translate.hpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Nico Madysa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENUMERATE_TRANSLATE_HPP
+#define ENUMERATE_TRANSLATE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+
+#include "../enumerate.hpp"
+#include "filter.hpp"
+
+
+namespace enumerate {
+
+/// A single pair of a `Translation`.
+template<typename From, typename To>
+struct TranslationEntry {
+    From from;
+    To to;
+};
+
+
+/**Trait that maps the items of an `enum` to another `enum` or to codes.
+ *
+ * The primary template is left undefined. `From` follows the
+ * `enumerate` protocol; `To` is either another such `enum` or a type of
+ * external codes, i.e. any integer or `enum` type. A specialization
+ * lists the pairs in any order:
+ *
+ * ```
+ * template<>
+ * struct enumerate::EnumTranslation<Status, WireStatus> {
+ *     static constexpr TranslationEntry<Status, WireStatus> entries[] = {
+ *         {Status::Ok, WireStatus::Ok},
+ *         {Status::NotFound, WireStatus::Missing},
+ *     };
+ * };
+ * ```
+ *
+ * A single declaration thus serves both directions; see `Translation`.
+ */
+template<typename From, typename To>
+struct EnumTranslation;
+
+
+namespace detail {
+
+/// Whether `T` is an `enum` that follows the `enumerate` protocol.
+template<typename T, typename = void>
+struct follows_protocol : std::false_type {};
+
+template<typename T>
+struct follows_protocol<T, std::void_t<decltype(T::BEGIN), decltype(T::END)>>
+    : std::is_enum<T> {};
+
+/// Return the integer value of an `enum` item or of an integer.
+template<typename T>
+constexpr std::int64_t code_value(T value) {
+    if constexpr (std::is_enum<T>::value) {
+        return static_cast<std::int64_t>(static_cast<std::underlying_type_t<T>>(value));
+    } else {
+        return static_cast<std::int64_t>(value);
+    }
+}
+
+/// Properties of and lookup tables for an `EnumTranslation`.
+template<typename From, typename To>
+struct TranslationTables {
+    using entries_type = decltype(EnumTranslation<From, To>::entries);
+    static constexpr std::size_t entry_count = std::extent<entries_type>::value;
+    static constexpr std::size_t from_count = Enumerate<From>::size();
+    static constexpr auto& entries = EnumTranslation<From, To>::entries;
+
+    /// Marks a slot without a preimage in the inverse table.
+    static constexpr std::uint32_t none = static_cast<std::uint32_t>(from_count);
+
+    /// Every `From` item occurs exactly once.
+    static constexpr bool total = [] {
+        std::array<bool, from_count> seen{};
+        for (std::size_t i = 0; i < entry_count; ++i) {
+            const From from = entries[i].from;
+            if (from < From::BEGIN || from >= From::END || seen[to_index(from)]) {
+                return false;
+            }
+            seen[to_index(from)] = true;
+        }
+        return entry_count == from_count;
+    }();
+
+    /// No two items map to the same target, and targets are in range.
+    static constexpr bool injective = [] {
+        for (std::size_t i = 0; i < entry_count; ++i) {
+            if constexpr (follows_protocol<To>::value) {
+                if (entries[i].to < To::BEGIN || entries[i].to >= To::END) {
+                    return false;
+                }
+            }
+            for (std::size_t j = 0; j < i; ++j) {
+                if (entries[i].to == entries[j].to) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }();
+
+    /// Smallest and largest target code.
+    static constexpr std::int64_t min_code = [] {
+        std::int64_t result = entry_count == 0 ? 0 : code_value(entries[0].to);
+        for (std::size_t i = 0; i < entry_count; ++i) {
+            result = code_value(entries[i].to) < result ? code_value(entries[i].to) : result;
+        }
+        if constexpr (follows_protocol<To>::value) {
+            result = code_value(To::BEGIN);
+        }
+        return result;
+    }();
+    static constexpr std::int64_t max_code = [] {
+        std::int64_t result = entry_count == 0 ? 0 : code_value(entries[0].to);
+        for (std::size_t i = 0; i < entry_count; ++i) {
+            result = code_value(entries[i].to) > result ? code_value(entries[i].to) : result;
+        }
+        if constexpr (follows_protocol<To>::value) {
+            result = code_value(To::END) - 1;
+        }
+        return result;
+    }();
+
+    /// Number of codes between the smallest and the largest, inclusive.
+    static constexpr std::size_t code_span =
+        max_code < min_code ? 0 : static_cast<std::size_t>(max_code - min_code) + 1;
+
+    /// The image of every `From` item, by position.
+    static constexpr std::array<To, from_count> forward = [] {
+        std::array<To, from_count> result{};
+        for (std::size_t i = 0; i < entry_count; ++i) {
+            result[to_index(entries[i].from)] = entries[i].to;
+        }
+        return result;
+    }();
+
+    /// Codes that span at most this many slots always get a dense inverse.
+    static constexpr std::size_t small_dense_span = 256;
+
+    /// `true` if the inverse is a table indexed by code. This is the case
+    /// if the span is small or if the codes fill at least a quarter of it;
+    /// sparser codes are inverted by binary search.
+    static constexpr bool dense_inverse =
+        code_span <= small_dense_span || code_span / 4 <= entry_count;
+
+    /// The position of the preimage of every code in `[min_code, max_code]`.
+    static constexpr auto inverse = [] {
+        std::array<std::uint32_t, dense_inverse ? code_span : 0> result{};
+        for (auto& slot : result) {
+            slot = none;
+        }
+        if constexpr (dense_inverse) {
+            for (std::size_t i = 0; i < entry_count; ++i) {
+                result[static_cast<std::size_t>(code_value(entries[i].to) - min_code)] =
+                    static_cast<std::uint32_t>(to_index(entries[i].from));
+            }
+        }
+        return result;
+    }();
+
+    /// The entries sorted by code, if the inverse is not dense.
+    static constexpr auto sorted = [] {
+        std::array<TranslationEntry<From, To>, dense_inverse ? 0 : entry_count> result{};
+        if constexpr (!dense_inverse) {
+            for (std::size_t i = 0; i < entry_count; ++i) {
+                std::size_t j = i;
+                for (; j > 0 && code_value(result[j - 1].to) > code_value(entries[i].to); --j) {
+                    result[j] = result[j - 1];
+                }
+                result[j] = entries[i];
+            }
+        }
+        return result;
+    }();
+
+    /// Return the position of the preimage of `value`, or `none`.
+    static constexpr std::uint32_t find_code(std::int64_t value) {
+        if (value < min_code || value > max_code) {
+            return none;
+        }
+        if constexpr (dense_inverse) {
+            return inverse[static_cast<std::size_t>(value - min_code)];
+        } else {
+            std::size_t first = 0;
+            std::size_t last = sorted.size();
+            while (first < last) {
+                const std::size_t middle = first + (last - first) / 2;
+                if (code_value(sorted[middle].to) < value) {
+                    first = middle + 1;
+                } else {
+                    last = middle;
+                }
+            }
+            return first < sorted.size() && code_value(sorted[first].to) == value
+                ? static_cast<std::uint32_t>(to_index(sorted[first].from)) : none;
+        }
+    }
+
+    /// The image bytes of up to 16 items, for `shuffle_translate()`.
+    static constexpr std::array<std::uint8_t, 16> forward_bytes = [] {
+        std::array<std::uint8_t, 16> result{};
+        for (std::size_t i = 0; i < from_count && i < 16; ++i) {
+            result[i] = static_cast<std::uint8_t>(code_value(forward[i]));
+        }
+        return result;
+    }();
+
+    /// A byte that is the value of no `From` item, or -1 if there is none.
+    static constexpr int unused_from_byte = [] {
+        std::array<bool, 256> used{};
+        for (std::size_t i = 0; i < from_count; ++i) {
+            used[static_cast<std::uint8_t>(code_value(from_index<From>(i)))] = true;
+        }
+        for (int byte = 0; byte < 256; ++byte) {
+            if (!used[byte]) {
+                return byte;
+            }
+        }
+        return -1;
+    }();
+
+    /// The preimage bytes of up to 16 codes, for `shuffle_translate()`.
+    static constexpr std::array<std::uint8_t, 16> inverse_bytes = [] {
+        std::array<std::uint8_t, 16> result{};
+        for (std::size_t i = 0; i < code_span && i < 16; ++i) {
+            result[i] = inverse[i] == none
+                ? static_cast<std::uint8_t>(unused_from_byte)
+                : static_cast<std::uint8_t>(code_value(from_index<From>(inverse[i])));
+        }
+        return result;
+    }();
+};
+
+#ifdef ENUMERATE_HAVE_SSSE3
+/**Translate `size` bytes through a table of 16 bytes.
+ *
+ * `out[i] = table[in[i] - offset]`. Returns the position of the first
+ * byte for which `in[i] - offset` is not below `limit` or the looked-up
+ * byte equals `invalid`; `size` if there is none. A negative `invalid`
+ * disables the latter check. Bytes from the returned position on may
+ * not have been written.
+ */
+inline std::size_t shuffle_translate(
+    const std::uint8_t* in, std::size_t size, std::uint8_t* out,
+    const std::uint8_t* table, std::uint8_t offset, std::uint8_t limit, int invalid
+) {
+    const __m128i lookup = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table));
+    const __m128i offsets = _mm_set1_epi8(static_cast<char>(offset));
+    const __m128i last = _mm_set1_epi8(static_cast<char>(limit - 1));
+    const __m128i invalids = _mm_set1_epi8(static_cast<char>(invalid));
+    std::size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        const __m128i index = _mm_sub_epi8(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)), offsets);
+        const __m128i in_range = _mm_cmpeq_epi8(_mm_min_epu8(index, last), index);
+        const __m128i result = _mm_shuffle_epi8(lookup, index);
+        __m128i bad = _mm_xor_si128(in_range, _mm_set1_epi8(-1));
+        if (invalid >= 0) {
+            bad = _mm_or_si128(bad, _mm_cmpeq_epi8(result, invalids));
+        }
+        if (_mm_movemask_epi8(bad) != 0) {
+            break;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), result);
+    }
+    for (; i < size; ++i) {
+        const std::uint8_t index = static_cast<std::uint8_t>(in[i] - offset);
+        if (index >= limit || table[index] == invalid) {
+            return i;
+        }
+        out[i] = table[index];
+    }
+    return size;
+}
+#endif
+
+}
+
+
+/**A validated translation between an `enum` and another `enum` or codes.
+ *
+ * The pairs are declared once, in `EnumTranslation<From, To>`, and this
+ * class derives dense lookup tables for both directions at compile
+ * time. Codes that are too sparse for a dense inverse table are
+ * inverted by binary search instead.
+ *
+ * `is_total` and `is_injective` tell whether the declaration is a total
+ * function and whether it is one-to-one; `convert()` requires the
+ * former and `invert()` the latter, so a forgotten or duplicate entry
+ * is a compile-time error. `is_bijective` additionally requires that a
+ * protocol `enum` `To` is covered completely.
+ *
+ * The bulk converters use a byte-shuffle lookup with SSSE3 if both
+ * types are one byte wide and a direction has at most 16 entries.
+ */
+template<typename From, typename To>
+class Translation {
+    using tables = detail::TranslationTables<From, To>;
+
+    /// Return the image of the item at position `index`.
+    static constexpr std::uint8_t forward_byte(std::size_t index) {
+        return static_cast<std::uint8_t>(detail::code_value(tables::forward[index]));
+    }
+
+public:
+    /// `true` if every `From` item is mapped exactly once.
+    static constexpr bool is_total = tables::total;
+
+    /// `true` if no two items are mapped to the same target.
+    static constexpr bool is_injective = tables::injective;
+
+    /// `true` if the mapping is total, one-to-one and onto.
+    static constexpr bool is_bijective = is_total && is_injective
+        && (!detail::follows_protocol<To>::value
+            || tables::entry_count == tables::code_span);
+
+    /// Return the image of `item`, which must be between `BEGIN` and `END`.
+    static constexpr To convert(From item) {
+        static_assert(is_total, "EnumTranslation must map every item exactly once");
+        return tables::forward[to_index(item)];
+    }
+
+    /// Return the item that is mapped to `code`, if there is one.
+    static constexpr std::optional<From> invert(To code) {
+        static_assert(is_injective, "EnumTranslation must not map two items to the same target");
+        const std::uint32_t index = tables::find_code(detail::code_value(code));
+        if (index == tables::none) {
+            return std::nullopt;
+        }
+        return from_index<From>(index);
+    }
+
+    /// Convert the `size` items at `in`, which must be between `BEGIN` and `END`.
+    static void convert(const From* in, std::size_t size, To* out) {
+        static_assert(is_total, "EnumTranslation must map every item exactly once");
+        std::size_t i = 0;
+#ifdef ENUMERATE_HAVE_SSSE3
+        if constexpr (sizeof(From) == 1 && sizeof(To) == 1 && tables::from_count <= 16) {
+            // Every index is valid, so no byte marks a missing image.
+            i = detail::shuffle_translate(
+                reinterpret_cast<const std::uint8_t*>(in), size,
+                reinterpret_cast<std::uint8_t*>(out), tables::forward_bytes.data(),
+                static_cast<std::uint8_t>(detail::code_value(From::BEGIN)),
+                static_cast<std::uint8_t>(tables::from_count), -1);
+        }
+#endif
+        for (; i < size; ++i) {
+            out[i] = tables::forward[to_index(in[i])];
+        }
+    }
+
+    /**Invert the `size` codes at `in`.
+     *
+     * Returns the position of the first code that no item is mapped to,
+     * or `size` if all codes were inverted. Codes from that position on
+     * are not written to `out`.
+     */
+    static std::size_t invert(const To* in, std::size_t size, From* out) {
+        static_assert(is_injective, "EnumTranslation must not map two items to the same target");
+#ifdef ENUMERATE_HAVE_SSSE3
+        if constexpr (sizeof(From) == 1 && sizeof(To) == 1 && tables::code_span <= 16) {
+            // Codes without a preimage look up a byte that is no item.
+            if constexpr (tables::unused_from_byte >= 0) {
+                return detail::shuffle_translate(
+                    reinterpret_cast<const std::uint8_t*>(in), size,
+                    reinterpret_cast<std::uint8_t*>(out), tables::inverse_bytes.data(),
+                    static_cast<std::uint8_t>(tables::min_code),
+                    static_cast<std::uint8_t>(tables::code_span), tables::unused_from_byte);
+            }
+        }
+#endif
+        for (std::size_t i = 0; i < size; ++i) {
+            const auto item = invert(in[i]);
+            if (!item) {
+                return i;
+            }
+            out[i] = *item;
+        }
+        return size;
+    }
+};
+
+
+/// Return the image of `item` under `EnumTranslation<From, To>`.
+template<typename To, typename From>
+constexpr To translate(From item) {
+    return Translation<From, To>::convert(item);
+}
+
+}
+
+#endif // ENUMERATE_TRANSLATE_HPP
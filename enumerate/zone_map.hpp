@@ -0,0 +1,209 @@
+/*
+ * enumerate/zone_map.hpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Nico Madysa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENUMERATE_ZONE_MAP_HPP
+#define ENUMERATE_ZONE_MAP_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "../enumerate.hpp"
+#include "containers.hpp"
+#include "filter.hpp"
+
+
+namespace enumerate {
+
+/**Per-block summaries of the items that occur in a column.
+ *
+ * The column is divided into blocks of `block_size()` rows, and for
+ * each block an `EnumSet` records which items occur in it. A filter
+ * for `column IN set` then only scans blocks whose summary intersects
+ * `set`. Blocks whose summary is a subset of `set` are selected as a
+ * whole without being scanned either. Queries for rare items thus
+ * skip almost the entire column.
+ *
+ * The zone map does not own the column; it must be kept in sync with
+ * the column by calling `append()` whenever rows are added.
+ */
+template<typename Enum>
+class ZoneMap {
+public:
+    /// The default number of rows per block.
+    static constexpr std::size_t default_block_size = 4096;
+
+    /**Create an empty zone map.
+     *
+     * \throws std::invalid_argument if `block_size` is not a positive
+     *         multiple of 64.
+     */
+    explicit ZoneMap(std::size_t block_size = default_block_size)
+        : m_block_size(block_size)
+    {
+        if (block_size == 0 || block_size % 64 != 0) {
+            throw std::invalid_argument("enumerate: zone map block size must be a multiple of 64");
+        }
+    }
+
+    /**Summarize the `size` items at `column`.
+     *
+     * \throws std::invalid_argument if `block_size` is not a positive
+     *         multiple of 64.
+     * \throws std::out_of_range if an item is not between `BEGIN` and `END`.
+     */
+    ZoneMap(const Enum* column, std::size_t size, std::size_t block_size = default_block_size)
+        : ZoneMap(block_size)
+    {
+        append(column, size);
+    }
+
+    /**Summarize a packed `column`.
+     *
+     * The rows are unpacked a block at a time rather than one by one.
+     *
+     * \throws std::invalid_argument if `block_size` is not a positive
+     *         multiple of 64.
+     * \throws std::out_of_range if an item is not between `BEGIN` and `END`.
+     */
+    explicit ZoneMap(const PackedColumn<Enum>& column, std::size_t block_size = default_block_size)
+        : ZoneMap(block_size)
+    {
+        constexpr std::size_t block_rows = detail::packed_block_rows<Enum>;
+        Enum buffer[block_rows];
+        for (std::size_t done = 0; done < column.size(); done += block_rows) {
+            const std::size_t rows = std::min(block_rows, column.size() - done);
+            column.unpack(done, rows, buffer);
+            append(buffer, rows);
+        }
+    }
+
+    /// Record that `item` was appended to the column.
+    /// \throws std::out_of_range if `item` is not between `BEGIN` and `END`;
+    ///         the zone map is left unchanged.
+    void append(Enum item) {
+        if (to_index(item) >= Enumerate<Enum>::size()) {
+            throw std::out_of_range("enumerate::ZoneMap::append");
+        }
+        if (m_rows % m_block_size == 0) {
+            m_summaries.emplace_back();
+        }
+        m_summaries.back().insert(item);
+        ++m_rows;
+    }
+
+    /// Record that the `size` items at `items` were appended to the column.
+    /// \throws std::out_of_range if an item is not between `BEGIN` and `END`;
+    ///         the items before it remain recorded.
+    void append(const Enum* items, std::size_t size) {
+        for (std::size_t i = 0; i < size; ++i) {
+            append(items[i]);
+        }
+    }
+
+    /// Return the number of summarized rows.
+    std::size_t rows() const { return m_rows; }
+
+    /// Return the number of rows per block.
+    std::size_t block_size() const { return m_block_size; }
+
+    /// Return the number of blocks.
+    std::size_t blocks() const { return m_summaries.size(); }
+
+    /// Return the set of items that occur in block `block`.
+    const EnumSet<Enum>& summary(std::size_t block) const { return m_summaries[block]; }
+
+    /// Return the number of blocks whose summary intersects `set`.
+    std::size_t candidate_blocks(const EnumSet<Enum>& set) const {
+        return static_cast<std::size_t>(std::count_if(
+            m_summaries.begin(), m_summaries.end(),
+            [&set](const EnumSet<Enum>& s) { return s.intersects(set); }));
+    }
+
+    /**Mark the rows of `column` that are in `set`, skipping blocks.
+     *
+     * `column` must hold the `rows()` items that this zone map summarizes;
+     * `bitmap` must have room for `bitmap_words(rows())` words.
+     */
+    void select_in(const Enum* column, const EnumSet<Enum>& set, std::uint64_t* bitmap) const {
+        const detail::SetFilter<Enum> filter{set};
+        for_each_block(set, bitmap, [&](std::size_t first, std::size_t count, std::uint64_t* out) {
+            filter(column + first, count, out);
+        });
+    }
+
+    /// Mark the rows of a packed `column` that are in `set`, skipping blocks.
+    void select_in(const PackedColumn<Enum>& column, const EnumSet<Enum>& set, std::uint64_t* bitmap) const {
+        const detail::SetFilter<Enum> filter{set};
+        for_each_block(set, bitmap, [&](std::size_t first, std::size_t count, std::uint64_t* out) {
+            detail::run_packed_filter(column, first, count, out, filter);
+        });
+    }
+
+private:
+    /**Call `scan(first, count, out)` for every block that needs a scan.
+     *
+     * Skipped blocks are cleared in `bitmap`, fully covered blocks are
+     * set without calling `scan`.
+     */
+    template<typename Scan>
+    void for_each_block(const EnumSet<Enum>& set, std::uint64_t* bitmap, Scan scan) const {
+        const std::size_t words_per_block = m_block_size / 64;
+        for (std::size_t block = 0; block < m_summaries.size(); ++block) {
+            const std::size_t first = block * m_block_size;
+            const std::size_t count = std::min(m_block_size, m_rows - first);
+            std::uint64_t* const out = bitmap + block * words_per_block;
+            const EnumSet<Enum>& summary = m_summaries[block];
+            if (!summary.intersects(set)) {
+                std::fill_n(out, bitmap_words(count), 0);
+            } else if (summary.is_subset_of(set)) {
+                std::fill_n(out, count / 64, ~std::uint64_t{0});
+                if (count % 64 != 0) {
+                    out[count / 64] = (std::uint64_t{1} << (count % 64)) - 1;
+                }
+            } else {
+                scan(first, count, out);
+            }
+        }
+    }
+
+    /// Number of rows per block; a multiple of 64.
+    std::size_t m_block_size;
+
+    /// Number of summarized rows.
+    std::size_t m_rows = 0;
+
+    /// The items that occur in each block.
+    std::vector<EnumSet<Enum>> m_summaries;
+};
+
+}
+
+#endif // ENUMERATE_ZONE_MAP_HPP